@@ -1,8 +1,8 @@
 #include "genIR.h"
 #include "ir.h"
 
-#define CONST_INT(num) new ConstantInt(module->int32_ty_, num)
-#define CONST_FLOAT(num) new ConstantFloat(module->float32_ty_, num)
+#define CONST_INT(num) module->get_const_int(module->int32_ty_, num)
+#define CONST_FLOAT(num) module->get_const_float(num)
 #define VOID_T (module->void_ty_)
 #define INT1_T (module->int1_ty_)
 #define INT32_T (module->int32_ty_)
@@ -794,16 +794,11 @@ void GenIR::visit(UnaryExpAST &ast) {
     } else if (ast.unaryExp) {
       ast.unaryExp->accept(*this);
       if (ast.op == UOP_MINUS) {
-        // 是整型常量
-        if (dynamic_cast<ConstantInt *>(recentVal)) {
-          auto temp = (ConstantInt *)recentVal;
-          temp->value_ = -temp->value_;
-          recentVal = temp;
-        } else {
-          auto temp = (ConstantFloat *)recentVal;
-          temp->value_ = -temp->value_;
-          recentVal = temp;
-        }
+        // 常量是共享的，不能原地取反
+        if (dynamic_cast<ConstantInt *>(recentVal))
+          recentVal = CONST_INT(-((ConstantInt *)recentVal)->value_);
+        else
+          recentVal = CONST_FLOAT(-((ConstantFloat *)recentVal)->value_);
       }
     } else {
       cout << "Function call in ConstExp!" << endl;
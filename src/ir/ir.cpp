@@ -51,6 +51,64 @@ const std::map<FCmpInst::FCmpOp, std::string> FCmpInst::FCmpOpName = {
 std::string print_as_op(Value *v, bool print_ty);
 std::string print_cmp_type(ICmpInst::ICmpOp op);
 std::string print_fcmp_type(FCmpInst::FCmpOp op);
+//-----------------------------------------------Arena-----------------------------------------------
+Arena *Arena::current_ = nullptr;
+std::atomic<uint64_t> Arena::next_id_{1};
+thread_local Arena::Chunk *Arena::local_chunk_ = nullptr;
+thread_local uint64_t Arena::local_id_ = 0;
+
+Arena::Arena() : prev_(current_), id_(next_id_++) { current_ = this; }
+
+Arena::~Arena() {
+  if (current_ == this)
+    current_ = prev_;
+  while (chunks_) {
+    Chunk *chunk = chunks_;
+    chunks_ = chunk->next;
+    for (char *p = (char *)(chunk + 1); p < chunk->cur;) {
+      auto header = (Header *)p;
+      if (header->kind == TYPE)
+        static_cast<Type *>((void *)(header + 1))->~Type();
+      else if (header->kind == VALUE)
+        static_cast<Value *>((void *)(header + 1))->~Value();
+      p += header->size;
+    }
+    free(chunk);
+  }
+}
+
+void *Arena::allocate(size_t size, Kind kind) {
+  const size_t align = alignof(std::max_align_t);
+  size_t need = sizeof(Header) + (size + align - 1) / align * align;
+  Chunk *chunk = local_chunk_;
+  if (local_id_ != id_ || chunk->cur + need > chunk->end) {
+    chunk = new_chunk(need);
+    // 大对象单独占用一块，不替换当前块
+    if (local_id_ != id_ || need <= CHUNK_SIZE / 4) {
+      local_chunk_ = chunk;
+      local_id_ = id_;
+    }
+  }
+  auto header = (Header *)chunk->cur;
+  header->size = need;
+  header->kind = kind;
+  chunk->cur += need;
+  return header + 1;
+}
+
+void Arena::release(void *ptr) { ((Header *)ptr - 1)->kind = DEAD; }
+
+Arena::Chunk *Arena::new_chunk(size_t size) {
+  size = std::max(size + sizeof(Chunk), CHUNK_SIZE);
+  auto chunk = (Chunk *)malloc(size);
+  chunk->cur = (char *)(chunk + 1);
+  chunk->end = (char *)chunk + size;
+  std::lock_guard<std::mutex> guard(mutex_);
+  chunk->next = chunks_;
+  chunks_ = chunk;
+  return chunk;
+}
+
 //-----------------------------------------------Type-----------------------------------------------
 std::string Type::print() {
   std::string type_ir;
@@ -97,6 +155,8 @@ std::string Type::print() {
 }
 
 //-----------------------------------------------Value-----------------------------------------------
+std::mutex Value::use_mutex_;
+
 void Value::replace_all_use_with(Value *new_val) {
   for (auto use : use_list_) {
     auto val = dynamic_cast<Instruction *>(use.val_);
@@ -111,6 +171,7 @@ bool Value::remove_used(Instruction *user, unsigned int i) {
     return false;
   }
   auto pos = user->use_pos_[i];
+  auto lock = lock_use_list();
   use_list_.erase(pos);
   user->operands_[i] =
       nullptr; // 表示user->use_pos_[i]失效了，提示set_operand不要再删除
@@ -553,6 +614,36 @@ std::string CallInst::print() {
   return instr_ir;
 }
 
+// 形如 call; ret call 或 call; br label_ret，其中返回块只有 ret void，
+// 或只有返回本块入值的 phi 与 ret phi
+bool CallInst::isTailCall() {
+  auto bb = this->parent_;
+  auto term = bb->get_terminator();
+  if (bb->instr_list_.size() < 2 ||
+      *std::prev(bb->instr_list_.end(), 2) != this)
+    return false;
+  auto returns = [&](Instruction *ret) {
+    return ret->num_ops_ == 0 || ret->get_operand(0) == this;
+  };
+  if (term->is_ret())
+    return returns(term);
+  if (term->num_ops_ != 1)
+    return false;
+  auto succ = static_cast<BasicBlock *>(term->get_operand(0));
+  auto &instrs = succ->instr_list_;
+  if (instrs.size() == 1)
+    return instrs.front()->is_ret() && instrs.front()->num_ops_ == 0;
+  if (instrs.size() != 2 || !instrs.front()->is_phi() ||
+      !instrs.back()->is_ret() || instrs.back()->num_ops_ == 0 ||
+      instrs.back()->get_operand(0) != instrs.front())
+    return false;
+  auto phi = instrs.front();
+  for (int i = 0; i < phi->num_ops_; i += 2)
+    if (phi->get_operand(i + 1) == bb)
+      return phi->get_operand(i) == this;
+  return false;
+}
+
 std::string BranchInst::print() {
   std::string instr_ir;
   instr_ir += instr_id2string_[this->op_id_];
@@ -1,11 +1,16 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <list>
 #include <map>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <string>
@@ -40,6 +45,7 @@ class GetElementPtrInst;
 class StoreInst;
 class LoadInst;
 class AllocaInst;
+class Loop;
 
 struct Use {
   Value *val_;
@@ -47,6 +53,48 @@ struct Use {
   Use(Value *val, unsigned int no) : val_(val), arg_no_(no) {}
 };
 
+//-----------------------------------------------Arena-----------------------------------------------
+// IR 对象（Type 与 Value）的区域分配器，由 Module 持有。
+// 对象在整块内存中顺序分配，不单独释放，Arena 析构时统一调用析构函数
+// 并归还整块内存。每个线程独占一个当前块，并行优化时分配不加锁，
+// 只有申请新块时加锁。
+class Arena {
+public:
+  enum Kind { DEAD, TYPE, VALUE };
+  // 构造后成为当前 Arena，析构时恢复为之前的 Arena
+  Arena();
+  ~Arena();
+  void *allocate(size_t size, Kind kind);
+  // 对象被 delete 或构造失败时调用，析构时不再处理该对象
+  static void release(void *ptr);
+
+  static Arena *current_; // 新建的 IR 对象所属的 Arena
+
+private:
+  struct alignas(std::max_align_t) Chunk {
+    Chunk *next;
+    char *cur;
+    char *end;
+  };
+  // 每个对象前的头部，记录占用的字节数与对象种类，用于析构时遍历
+  struct alignas(std::max_align_t) Header {
+    uint32_t size;
+    uint32_t kind;
+  };
+  static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+  Chunk *new_chunk(size_t size);
+
+  Chunk *chunks_ = nullptr; // 全部块组成的链表
+  Arena *prev_;
+  uint64_t id_; // 区分先后创建的 Arena，线程缓存的块只属于一个 Arena
+  std::mutex mutex_;
+  static std::atomic<uint64_t> next_id_;
+  // 当前线程正在使用的块及其所属 Arena 的编号
+  static thread_local Chunk *local_chunk_;
+  static thread_local uint64_t local_id_;
+};
+
 //-----------------------------------------------Type-----------------------------------------------
 class Type {
 public:
@@ -60,7 +108,11 @@ public:
     PointerTyID,  // Pointer
   };
   explicit Type(TypeID tid) : tid_(tid) {}
-  ~Type() = default;
+  virtual ~Type() = default;
+  static void *operator new(size_t size) {
+    return Arena::current_->allocate(size, Arena::TYPE);
+  }
+  static void operator delete(void *ptr) { Arena::release(ptr); }
   virtual std::string print();
   TypeID tid_;
 };
@@ -109,22 +161,31 @@ class Value {
 public:
   explicit Value(Type *ty, const std::string &name = "")
       : type_(ty), name_(name) {}
-  ~Value() = default;
+  virtual ~Value() = default;
+  static void *operator new(size_t size) {
+    return Arena::current_->allocate(size, Arena::VALUE);
+  }
+  static void operator delete(void *ptr) { Arena::release(ptr); }
   virtual std::string print() = 0;
 
   void remove_use(Value *val) {
+    auto lock = lock_use_list();
     auto is_val = [val](const Use &use) { return use.val_ == val; };
     use_list_.remove_if(is_val);
   }
 
   //******************************************************************
   std::list<Use>::iterator add_use(Value *val, unsigned arg_no) {
+    auto lock = lock_use_list();
     use_list_.emplace_back(Use(val, arg_no));
     std::list<Use>::iterator re = use_list_.end();
     return --re;
   }
   // 删除迭代器指出的use
-  void remove_use(std::list<Use>::iterator it) { use_list_.erase(it); }
+  void remove_use(std::list<Use>::iterator it) {
+    auto lock = lock_use_list();
+    use_list_.erase(it);
+  }
   // user的第i个操作数准备不再使用this，因此删除this与user相关的use联系
   bool remove_used(Instruction *user, unsigned int i);
 
@@ -134,6 +195,16 @@ public:
   //******************************************************************
 
   void replace_all_use_with(Value *new_val);
+
+  // 常量、全局变量与函数可能被多个函数中的指令使用，并行优化各个函数时
+  // 对其 use_list_ 的修改需要互斥；函数内的值只由一个线程访问，不加锁
+  std::unique_lock<std::mutex> lock_use_list() {
+    return shared_ ? std::unique_lock<std::mutex>(use_mutex_)
+                   : std::unique_lock<std::mutex>();
+  }
+  bool shared_ = false;
+  static std::mutex use_mutex_;
+
   Type *type_;
   std::string name_;
   std::list<Use>
@@ -144,7 +215,9 @@ public:
 // 常量都是无名的(name=="")
 class Constant : public Value {
 public:
-  Constant(Type *ty, const std::string &name = "") : Value(ty, name) {}
+  Constant(Type *ty, const std::string &name = "") : Value(ty, name) {
+    shared_ = true;
+  }
   ~Constant() = default;
 };
 
@@ -197,29 +270,42 @@ public:
     int32_ty_ = new IntegerType(32);
     float32_ty_ = new Type(Type::FloatTyID);
   }
-  ~Module() {
-    delete void_ty_;
-    delete label_ty_;
-    delete int1_ty_;
-    delete int32_ty_;
-    delete float32_ty_;
-  }
   virtual std::string print();
   void add_global_variable(GlobalVariable *g) { global_list_.push_back(g); }
   void add_function(Function *f) { function_list_.push_back(f); }
   PointerType *get_pointer_type(Type *contained) {
+    std::lock_guard<std::mutex> guard(type_mutex_);
     if (!pointer_map_.count(contained)) {
       pointer_map_[contained] = new PointerType(contained);
     }
     return pointer_map_[contained];
   }
   ArrayType *get_array_type(Type *contained, unsigned num_elements) {
+    std::lock_guard<std::mutex> guard(type_mutex_);
     if (!array_map_.count({contained, num_elements})) {
       array_map_[{contained, num_elements}] =
           new ArrayType(contained, num_elements);
     }
     return array_map_[{contained, num_elements}];
   }
+  // 常量按类型与值唯一化，相同的常量是同一个对象，可以直接比较指针
+  ConstantInt *get_const_int(Type *ty, int val) {
+    std::lock_guard<std::mutex> guard(const_mutex_);
+    if (!const_int_map_.count({ty, val})) {
+      const_int_map_[{ty, val}] = new ConstantInt(ty, val);
+    }
+    return const_int_map_[{ty, val}];
+  }
+  // 浮点常量按位比较，0.0 与 -0.0 是不同的常量
+  ConstantFloat *get_const_float(float val) {
+    uint32_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    std::lock_guard<std::mutex> guard(const_mutex_);
+    if (!const_float_map_.count(bits)) {
+      const_float_map_[bits] = new ConstantFloat(float32_ty_, val);
+    }
+    return const_float_map_[bits];
+  }
 
   Function *getMainFunc();
 
@@ -233,6 +319,14 @@ public:
   Type *void_ty_;
   std::map<Type *, PointerType *> pointer_map_;
   std::map<std::pair<Type *, int>, ArrayType *> array_map_;
+  std::map<std::pair<Type *, int>, ConstantInt *> const_int_map_;
+  std::map<uint32_t, ConstantFloat *> const_float_map_;
+  // 各函数并行优化时可能同时创建类型与常量
+  std::mutex type_mutex_, const_mutex_;
+
+private:
+  // 模块中的全部类型与值都从这里分配，随模块一起释放
+  Arena arena_;
 };
 
 //-----------------------------------------------GlobalVariable-----------------------------------------------
@@ -244,6 +338,7 @@ public:
                  Constant *init = nullptr)
       : Value(m->get_pointer_type(ty), name), is_const_(is_const),
         init_val_(init) {
+    shared_ = true;
     m->add_global_variable(this);
   }
   virtual std::string print() override;
@@ -269,6 +364,7 @@ class Function : public Value {
 public:
   Function(FunctionType *ty, const std::string &name, Module *parent)
       : Value(ty, name), parent_(parent), seq_cnt_(0) {
+    shared_ = true;
     parent->add_function(this);
     size_t num_args = ty->args_.size();
     use_ret_cnt = 0;
@@ -276,7 +372,6 @@ public:
       arguments_.push_back(new Argument(ty->args_[i], "", this, i));
     }
   }
-  ~Function();
   virtual std::string print() override;
   void add_basic_block(BasicBlock *bb) { basic_blocks_.push_back(bb); }
   Type *get_return_type() const {
@@ -293,6 +388,7 @@ public:
   unsigned seq_cnt_;
   std::vector<std::set<Value *>> vreg_set_;
   int use_ret_cnt; // 程序中真正使用返回值的次数
+  std::vector<Loop *> loops_; // 全部自然循环，外层循环在前
 };
 //-----------------------------------------------BasicBlock-----------------------------------------------
 // 注：BasicBlock一定是LabelTyID
@@ -356,7 +452,10 @@ public:
   std::set<BasicBlock *> dom_frontier_;
   std::set<BasicBlock *> rdom_frontier_;
   std::set<BasicBlock *> rdoms_;
-  BasicBlock *idom_;
+  BasicBlock *idom_ = nullptr;
+  /****************api about loop****************/
+  Loop *loop_ = nullptr; // 所在的最内层循环，不在循环中时为空
+  int loop_depth_ = 0;
   std::set<Value *> live_in;
   std::set<Value *> live_out;
 };
@@ -452,6 +551,7 @@ public:
     }
     // 后面操作数的位置要做相应修改
     for (int i = index2 + 1; i < operands_.size(); i++) {
+      auto lock = operands_[i]->lock_use_list();
       for (auto &use : operands_[i]->use_list_) {
         if (use.val_ == this) {
           use.arg_no_ -= index2 - index1 + 1;
@@ -631,6 +731,8 @@ public:
     set_operand(num_ops - 1, func);
   }
   virtual std::string print() override;
+  // 调用结果直接作为函数返回值（或返回 void），调用后不再执行其他计算
+  bool isTailCall();
 };
 
 // 注：br的返回值类型一定是VoidTyID
@@ -1,13 +1,11 @@
-#include "CombineInstr.h"
-#include "ConstSpread.h"
-#include "LoopInvariant.h"
-#include "SimplifyJump.h"
+#include "LoopInfo.h"
+#include "LoopUnroll.h"
+#include "PassManager.h"
 #include "ast.h"
 #include "backend.h"
 #include "define.h"
 #include "genIR.h"
-#include "DeleteDeadCode.h"
-#include "opt.h"
+#include "utils.h"
 #include <fstream>
 #include <iostream>
 #include <ostream>
@@ -29,8 +27,34 @@ int main(int argc, char **argv) {
   std::string output = "-";
 
   int opt;
-  bool isO2 = false;
-  while ((opt = getopt(argc, argv, "Sco:O::")) != -1) {
+  int optLevel = 0; // -O 与 -O1 开启 IR 优化，-O2 另外使用图着色寄存器分配
+  // -j N 使用 N 个线程逐函数并行优化与生成代码，
+  // 输出的 IR 与汇编与线程数及运行次数无关
+  int jobs = 0;
+  // -passes=a,b,c 指定 IR 优化流水线，替代 -O 给出的默认流水线
+  std::string passes;
+  bool customPasses = false;
+  // getopt 无法处理长选项，先行取出
+  int argCount = 1;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.rfind("-passes=", 0) == 0) {
+      passes = arg.substr(8);
+      customPasses = true;
+    } else if (arg == "-ftime-report")
+      enableTimeReport = true;
+    else if (arg == "-stats")
+      enableStats = true;
+    // -unroll-factor=N 部分展开的份数，-unroll-threshold=N 展开后的规模上限
+    else if (arg.rfind("-unroll-factor=", 0) == 0)
+      LoopUnroll::factor = std::stoi(arg.substr(15));
+    else if (arg.rfind("-unroll-threshold=", 0) == 0)
+      LoopUnroll::fullThreshold = std::stoi(arg.substr(18));
+    else
+      argv[argCount++] = argv[i];
+  }
+  argc = argCount;
+  while ((opt = getopt(argc, argv, "Sco:O::j:")) != -1) {
     switch (opt) {
     case 'S':
       print_asm = true;
@@ -44,13 +68,17 @@ int main(int argc, char **argv) {
       output = optarg;
       break;
     case 'O':
-      isO2 = true;
+      optLevel = optarg == nullptr ? 1 : atoi(optarg);
+      break;
+    case 'j':
+      jobs = atoi(optarg);
       break;
     default:
       break;
     }
   }
   filename = argv[optind];
+  setThreadPoolSize(jobs);
 
   yyin = fopen(filename, "r");
   if (yyin == nullptr) {
@@ -59,26 +87,31 @@ int main(int argc, char **argv) {
   }
 
   // Frontend parser
-  yyparse();
+  {
+    PhaseTimer timer("parse");
+    yyparse();
+  }
 
   // Generate IR from AST
   GenIR genIR;
-  root->accept(genIR);
-  std::unique_ptr<Module> m = genIR.getModule();
+  std::unique_ptr<Module> m;
+  {
+    PhaseTimer timer("genir");
+    root->accept(genIR);
+    m = genIR.getModule();
+  }
 
   // Run IR optimization
-  // TODO
-  if (isO2) {
-    std::vector<Optimization *> Opt;
-    Opt.push_back(new DeadCodeDeletion(m.get()));
-    Opt.push_back(new ConstSpread(m.get()));
-    Opt.push_back(new CombineInstr(m.get()));
-    Opt.push_back(new DomainTree(m.get()));
-    Opt.push_back(new SimplifyJump(m.get()));
-    Opt.push_back(new LoopInvariant(m.get()));
-    Opt.push_back(new SimplifyJump(m.get()));
-    for (auto x : Opt)
-      x->execute();
+  PassManager passManager(m.get());
+  passManager.jobs = jobs;
+  if (customPasses) {
+    if (!passManager.parsePipeline(passes))
+      return -1;
+  } else if (optLevel > 0)
+    passManager.addDefaultPipeline();
+  {
+    PhaseTimer timer("opt");
+    passManager.run();
   }
 
   // Open output file
@@ -92,17 +125,36 @@ int main(int argc, char **argv) {
   }
 
   // Print IR result
-  const std::string IR = m->print();
-  if (print_ir) {
-    *out << IR << std::endl;
+  std::string IR;
+  {
+    PhaseTimer timer("output");
+    IR = m->print();
+    if (print_ir) {
+      *out << IR << std::endl;
+    }
   }
 
   // Generate assembly file
-  // TODO
   if (print_asm) {
     auto builder = new RiscvBuilder();
-    const std::string RiscvCode = builder->buildRISCV(m.get());
+    builder->graphColoring = optLevel >= 2;
+    std::string RiscvCode;
+    {
+      PhaseTimer timer("codegen");
+      // 寄存器分配按 BasicBlock::loop_depth_ 估计溢出代价
+      LoopInfo(m.get()).execute();
+      RiscvCode = builder->buildRISCV(m.get());
+    }
+    PhaseTimer timer("output");
     *out << RiscvCode << std::endl;
   }
+
+  // 统计信息输出到 stderr，避免与 -o - 的输出混在一起
+  if (enableTimeReport) {
+    out->flush();
+    printTimeReport(std::cerr);
+  }
+  if (enableStats)
+    printStats(std::cerr);
   return 0;
 }
@@ -0,0 +1,203 @@
+#include "AliasAnalysis.h"
+
+static Function *getCallee(Instruction *call) {
+  return static_cast<Function *>(call->get_operand(call->num_ops_ - 1));
+}
+
+Value *getBasePtr(Value *ptr) {
+  while (true) {
+    auto instr = dynamic_cast<Instruction *>(ptr);
+    if (instr == nullptr ||
+        !(instr->is_gep() || instr->op_id_ == Instruction::BitCast))
+      return ptr;
+    ptr = instr->get_operand(0);
+  }
+}
+
+bool AliasAnalysis::callMayWrite(Instruction *call) {
+  return info->getCallEffect(call).writeMemory();
+}
+
+bool AliasAnalysis::callMayRead(Instruction *call) {
+  return info->getCallEffect(call).readMemory();
+}
+
+// 从没有调用点的函数（main）的形参未知开始，将实参所指的对象并入形参，
+// 直到不再变化；实参所指对象无法确定时形参也标记为未知
+void AliasAnalysis::computeArgObjects(Module *m) {
+  std::vector<Instruction *> calls;
+  std::set<Function *> called;
+  for (auto foo : m->function_list_)
+    for (auto bb : foo->basic_blocks_)
+      for (auto instr : bb->instr_list_)
+        if (instr->is_call() && !getCallee(instr)->basic_blocks_.empty()) {
+          calls.push_back(instr);
+          called.insert(getCallee(instr));
+        }
+  std::set<Argument *> unknown;
+  for (auto foo : m->function_list_)
+    for (auto arg : foo->arguments_)
+      if (arg->type_->tid_ == Type::PointerTyID) {
+        if (called.count(foo))
+          argObjects[arg] = {};
+        else
+          unknown.insert(arg);
+      }
+
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (auto call : calls) {
+      auto callee = getCallee(call);
+      for (int i = 0; i + 1 < call->num_ops_; i++) {
+        auto formal = callee->arguments_[i];
+        if (formal->type_->tid_ != Type::PointerTyID || unknown.count(formal))
+          continue;
+        auto base = getBasePtr(call->get_operand(i));
+        auto arg = dynamic_cast<Argument *>(base);
+        std::set<Value *> objects;
+        if (dynamic_cast<GlobalVariable *>(base) ||
+            dynamic_cast<AllocaInst *>(base))
+          objects.insert(base);
+        else if (arg && !unknown.count(arg))
+          objects = argObjects[arg];
+        else {
+          unknown.insert(formal);
+          argObjects.erase(formal);
+          changed = true;
+          continue;
+        }
+        for (auto obj : objects)
+          changed |= argObjects[formal].insert(obj).second;
+      }
+    }
+  }
+}
+
+AliasAnalysis::Location AliasAnalysis::decompose(Value *ptr) {
+  Location loc;
+  while (auto instr = dynamic_cast<Instruction *>(ptr)) {
+    if (instr->is_gep()) {
+      auto ty =
+          static_cast<PointerType *>(instr->get_operand(0)->type_)->contained_;
+      for (int i = 1; i < instr->num_ops_; i++) {
+        // 第 i 个下标每增加 1，地址增加 ty 所含的元素个数
+        int size = 1;
+        for (auto t = ty; t->tid_ == Type::ArrayTyID;
+             t = static_cast<ArrayType *>(t)->contained_)
+          size *= static_cast<ArrayType *>(t)->num_elements_;
+        addIndex(loc, instr->get_operand(i), size);
+        if (i + 1 < instr->num_ops_)
+          ty = static_cast<ArrayType *>(ty)->contained_;
+      }
+    } else if (instr->op_id_ != Instruction::BitCast)
+      break;
+    ptr = instr->get_operand(0);
+  }
+  loc.base = ptr;
+  return loc;
+}
+
+// 拆出下标中与常量相加减、相乘的部分
+void AliasAnalysis::addIndex(Location &loc, Value *idx, int size) {
+  if (auto cidx = dynamic_cast<ConstantInt *>(idx)) {
+    loc.offset += cidx->value_ * size;
+    return;
+  }
+  auto instr = dynamic_cast<Instruction *>(idx);
+  if (instr && (instr->is_add() || instr->is_sub() || instr->is_mul())) {
+    Value *other = instr->get_operand(0);
+    auto cval = dynamic_cast<ConstantInt *>(instr->get_operand(1));
+    if (cval == nullptr && !instr->is_sub()) {
+      other = instr->get_operand(1);
+      cval = dynamic_cast<ConstantInt *>(instr->get_operand(0));
+    }
+    if (cval != nullptr) {
+      if (instr->is_mul())
+        addIndex(loc, other, size * cval->value_);
+      else {
+        loc.offset += (instr->is_add() ? 1 : -1) * cval->value_ * size;
+        addIndex(loc, other, size);
+      }
+      return;
+    }
+  }
+  if ((loc.terms[idx] += size) == 0)
+    loc.terms.erase(idx);
+}
+
+bool AliasAnalysis::isDisjoint(Value *base1, Value *base2) {
+  auto isAlloca = [](Value *val) { return dynamic_cast<AllocaInst *>(val); };
+  auto isArg = [](Value *val) { return dynamic_cast<Argument *>(val); };
+  if ((isAlloca(base1) && isArg(base2)) || (isArg(base1) && isAlloca(base2)))
+    return true;
+  // 基址可能指向的对象，无法确定时返回空
+  auto getObjects = [&](Value *base) -> const std::set<Value *> * {
+    static thread_local std::set<Value *> single;
+    if (dynamic_cast<GlobalVariable *>(base) || isAlloca(base)) {
+      single = {base};
+      return &single;
+    }
+    auto iter = argObjects.find(dynamic_cast<Argument *>(base));
+    return iter == argObjects.end() ? nullptr : &iter->second;
+  };
+  std::set<Value *> objects1;
+  auto objects = getObjects(base1);
+  if (objects == nullptr)
+    return false;
+  objects1 = *objects;
+  objects = getObjects(base2);
+  if (objects == nullptr)
+    return false;
+  for (auto obj : *objects)
+    if (objects1.count(obj))
+      return false;
+  return true;
+}
+
+bool AliasAnalysis::isVariant(Value *val, BasicBlock *crossLoop) {
+  auto instr = dynamic_cast<Instruction *>(val);
+  return crossLoop && instr &&
+         (instr->parent_ == crossLoop ||
+          crossLoop->isDominate(instr->parent_) == 1);
+}
+
+AliasResult AliasAnalysis::alias(Value *ptr1, Value *ptr2,
+                                 BasicBlock *crossLoop) {
+  auto loc1 = decompose(ptr1), loc2 = decompose(ptr2);
+  if (loc1.base != loc2.base)
+    return isDisjoint(loc1.base, loc2.base) ? NoAlias : MayAlias;
+  if (loc1.terms != loc2.terms || isVariant(loc1.base, crossLoop))
+    return MayAlias;
+  for (auto [val, size] : loc1.terms)
+    if (isVariant(val, crossLoop))
+      return MayAlias;
+  return loc1.offset == loc2.offset ? MustAlias : NoAlias;
+}
+
+bool AliasAnalysis::mayAccess(Instruction *instr, Value *ptr, bool writeOnly,
+                              BasicBlock *crossLoop) {
+  if (instr->is_store())
+    return alias(instr->get_operand(1), ptr, crossLoop) != NoAlias;
+  if (instr->is_load())
+    return !writeOnly &&
+           alias(instr->get_operand(0), ptr, crossLoop) != NoAlias;
+  if (!instr->is_call())
+    return false;
+  // 按被调函数的摘要判断：全局变量（以及可能指向全局变量的形参）可能被
+  // 直接访问，指针实参所指的对象可能经形参访问
+  auto &effect = info->getCallEffect(instr);
+  bool global = effect.writeGlobal || (!writeOnly && effect.readGlobal);
+  bool arg = effect.writeArg || (!writeOnly && effect.readArg);
+  auto base = getBasePtr(ptr);
+  if (global && !dynamic_cast<AllocaInst *>(base))
+    return true;
+  if (!arg)
+    return false;
+  for (int i = 0; i + 1 < instr->num_ops_; i++) {
+    auto argBase = getBasePtr(instr->get_operand(i));
+    if (instr->get_operand(i)->type_->tid_ == Type::PointerTyID &&
+        (argBase == base || !isDisjoint(argBase, base)))
+      return true;
+  }
+  return false;
+}
@@ -0,0 +1,50 @@
+#ifndef ALIASANALYSISH
+#define ALIASANALYSISH
+
+#include "FuncInfo.h"
+
+// 指针所指对象：去掉 getelementptr 与 bitcast 后的全局变量、alloca 或形参
+Value *getBasePtr(Value *ptr);
+
+enum AliasResult { NoAlias, MayAlias, MustAlias };
+
+// 别名分析：
+// 1. 不同的全局变量与局部数组互不重叠，形参不会指向本函数栈帧中的局部数组；
+// 2. 形参可能指向的对象由模块内的全部调用点确定，无法确定时按可能别名处理；
+// 3. 同一对象上的地址分解为常量偏移与变量下标之和，变量部分相同时比较常量偏移。
+// 两次访问可能属于以 crossLoop 为头的循环的不同迭代时，支配于循环头的值
+// 在两次访问时可能不同，只比较不含这些值的地址。
+// 形参的信息在构造时计算，之后新增调用点（如内联）需要重新构造。
+class AliasAnalysis {
+  FuncInfo *info;
+  // 地址 = base + offset + sum(terms[v] * v)，以 4 字节的元素为单位
+  struct Location {
+    Value *base;
+    int offset = 0;
+    std::map<Value *, int> terms;
+  };
+  // 形参可能指向的全局变量与局部数组，无法确定的形参不记录
+  std::map<Argument *, std::set<Value *>> argObjects;
+
+  void computeArgObjects(Module *m);
+  Location decompose(Value *ptr);
+  void addIndex(Location &loc, Value *idx, int size);
+  // 两个不同的基址一定指向不同的对象
+  bool isDisjoint(Value *base1, Value *base2);
+  // 值在 crossLoop 的不同迭代中可能不同
+  bool isVariant(Value *val, BasicBlock *crossLoop);
+
+public:
+  AliasAnalysis(Module *m, FuncInfo *info_) : info(info_) {
+    computeArgObjects(m);
+  }
+  AliasResult alias(Value *ptr1, Value *ptr2, BasicBlock *crossLoop = nullptr);
+  // 调用可能写入或读取内存
+  bool callMayWrite(Instruction *call);
+  bool callMayRead(Instruction *call);
+  // 指令可能读写（writeOnly 时只考虑写入）ptr 所指的内存
+  bool mayAccess(Instruction *instr, Value *ptr, bool writeOnly,
+                 BasicBlock *crossLoop = nullptr);
+};
+
+#endif // !ALIASANALYSISH
@@ -1,6 +1,7 @@
 #include "BasicOperation.h"
 
 void deleteUse(Value *opnd, Instruction *inst) {
+  auto lock = opnd->lock_use_list();
   for (auto it = opnd->use_list_.begin(); it != opnd->use_list_.end(); ++it)
     if (it->val_ == inst) {
       opnd->use_list_.erase(it);
@@ -45,10 +46,113 @@ void DeleteUnusedBB(Function *func) {
       dfsGraph(bb, vis);
       break;
     }
+  std::vector<BasicBlock *> uselessBB;
   for (auto bb : func->basic_blocks_)
-    if (vis.find(bb) == vis.end()) {
-      bb->parent_->remove_bb(bb);
-      for (auto suc : bb->succ_bbs_)
-        SolvePhi(bb, suc);
+    if (vis.find(bb) == vis.end())
+      uselessBB.push_back(bb);
+  for (auto bb : uselessBB) {
+    bb->parent_->remove_bb(bb);
+    for (auto suc : bb->succ_bbs_)
+      SolvePhi(bb, suc);
+    // 删除块内指令对操作数的使用，避免残留在 use_list_ 中
+    for (auto instr : bb->instr_list_)
+      instr->remove_use_of_ops();
+  }
+}
+
+// bb 是前驱的唯一后继且只有这一个前驱时，将 bb 并入前驱，返回是否合并
+bool MergeIntoPreBB(BasicBlock *bb) {
+  if (bb->pre_bbs_.size() != 1)
+    return false;
+  auto pre = bb->pre_bbs_.front();
+  if (pre == bb || pre->succ_bbs_.size() != 1)
+    return false;
+  pre->delete_instr(pre->get_terminator());
+  std::vector<Instruction *> instrs(bb->instr_list_.begin(),
+                                    bb->instr_list_.end());
+  for (auto instr : instrs) {
+    if (instr->is_phi()) {
+      instr->replace_all_use_with(instr->get_operand(0));
+      bb->delete_instr(instr);
+      continue;
     }
+    bb->remove_instr(instr);
+    pre->add_instruction(instr);
+  }
+  pre->succ_bbs_.clear();
+  for (auto succ : bb->succ_bbs_) {
+    pre->add_succ_basic_block(succ);
+    succ->remove_pre_basic_block(bb);
+    succ->add_pre_basic_block(pre);
+  }
+  // 后继 phi 中的入边改为前驱
+  bb->replace_all_use_with(pre);
+  bb->pre_bbs_.clear();
+  bb->succ_bbs_.clear();
+  bb->parent_->remove_bb(bb);
+  return true;
+}
+
+// 按 valueMap 替换操作数，在 bb 末尾复制一条指令。
+// phi 只创建不填写入值，局部数组的栈空间放在所在函数的入口块中
+Instruction *CloneInstr(Instruction *instr, BasicBlock *bb,
+                        std::map<Value *, Value *> &valueMap) {
+  auto op = [&](int i) {
+    auto iter = valueMap.find(instr->get_operand(i));
+    return iter == valueMap.end() ? instr->get_operand(i) : iter->second;
+  };
+  auto block = [&](int i) { return static_cast<BasicBlock *>(op(i)); };
+  switch (instr->op_id_) {
+  case Instruction::FNeg:
+    return new UnaryInst(instr->type_, instr->op_id_, op(0), bb);
+  case Instruction::ICmp:
+    return new ICmpInst(static_cast<ICmpInst *>(instr)->icmp_op_, op(0), op(1),
+                        bb);
+  case Instruction::FCmp:
+    return new FCmpInst(static_cast<FCmpInst *>(instr)->fcmp_op_, op(0), op(1),
+                        bb);
+  case Instruction::Alloca:
+    return new AllocaInst(static_cast<AllocaInst *>(instr)->alloca_ty_,
+                          bb->parent_->basic_blocks_.front());
+  case Instruction::Load:
+    return new LoadInst(op(0), bb);
+  case Instruction::Store:
+    return new StoreInst(op(0), op(1), bb);
+  case Instruction::GetElementPtr: {
+    std::vector<Value *> idxs;
+    for (int i = 1; i < instr->num_ops_; i++)
+      idxs.push_back(op(i));
+    return new GetElementPtrInst(op(0), idxs, bb);
+  }
+  case Instruction::ZExt:
+    return new ZextInst(instr->op_id_, op(0), instr->type_, bb);
+  case Instruction::FPtoSI:
+    return new FpToSiInst(instr->op_id_, op(0), instr->type_, bb);
+  case Instruction::SItoFP:
+    return new SiToFpInst(instr->op_id_, op(0), instr->type_, bb);
+  case Instruction::BitCast:
+    return new Bitcast(instr->op_id_, op(0), instr->type_, bb);
+  case Instruction::Call: {
+    std::vector<Value *> args;
+    for (int i = 0; i + 1 < instr->num_ops_; i++)
+      args.push_back(op(i));
+    return new CallInst(static_cast<Function *>(op(instr->num_ops_ - 1)), args,
+                        bb);
+  }
+  case Instruction::Br:
+    if (instr->num_ops_ == 1)
+      return new BranchInst(block(0), bb);
+    return new BranchInst(op(0), block(1), block(2), bb);
+  case Instruction::PHI: {
+    auto phi = PhiInst::create_phi(instr->type_, bb);
+    bb->add_instruction(phi);
+    return phi;
+  }
+  default:
+    assert(instr->is_binary() || instr->op_id_ == Instruction::UDiv ||
+           instr->op_id_ == Instruction::URem ||
+           (instr->op_id_ >= Instruction::Shl &&
+            instr->op_id_ <= Instruction::Xor));
+    return new BinaryInst(instr->type_, instr->op_id_, op(0), op(1), bb);
+  }
 }
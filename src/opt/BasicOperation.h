@@ -11,5 +11,8 @@ void deleteUse(Value* opnd,Instruction *inst);
 void dfsGraph(BasicBlock *bb, std::set<BasicBlock *> &vis);
 void SolvePhi(BasicBlock *bb, BasicBlock *succ_bb);
 void DeleteUnusedBB(Function *func);
+bool MergeIntoPreBB(BasicBlock *bb);
+Instruction *CloneInstr(Instruction *instr, BasicBlock *bb,
+                        std::map<Value *, Value *> &valueMap);
 
 #endif // !BASICOPERATION
\ No newline at end of file
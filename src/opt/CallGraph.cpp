@@ -0,0 +1,81 @@
+#include "CallGraph.h"
+#include <algorithm>
+
+CallGraph::CallGraph(Module *m) {
+  for (auto foo : m->function_list_) {
+    if (foo->basic_blocks_.empty())
+      continue;
+    auto &callees = calleesOf[foo];
+    for (auto bb : foo->basic_blocks_)
+      for (auto instr : bb->instr_list_) {
+        if (!instr->is_call())
+          continue;
+        auto callee =
+            static_cast<Function *>(instr->get_operand(instr->num_ops_ - 1));
+        if (callee->basic_blocks_.empty() ||
+            std::find(callees.begin(), callees.end(), callee) != callees.end())
+          continue;
+        callees.push_back(callee);
+        callersOf[callee].push_back(foo);
+      }
+  }
+  for (auto foo : m->function_list_)
+    if (!foo->basic_blocks_.empty() && !dfn.count(foo))
+      tarjan(foo);
+}
+
+// 分量在其全部后继分量之后出栈，得到的顺序即为自底向上
+void CallGraph::tarjan(Function *foo) {
+  int index = dfn.size();
+  dfn[foo] = low[foo] = index;
+  stack.push_back(foo);
+  onStack.insert(foo);
+  for (auto callee : calleesOf[foo]) {
+    if (!dfn.count(callee)) {
+      tarjan(callee);
+      low[foo] = std::min(low[foo], low[callee]);
+    } else if (onStack.count(callee))
+      low[foo] = std::min(low[foo], dfn[callee]);
+  }
+  if (low[foo] != dfn[foo])
+    return;
+  std::vector<Function *> scc;
+  Function *top;
+  do {
+    top = stack.back();
+    stack.pop_back();
+    onStack.erase(top);
+    sccOf[top] = sccs.size();
+    scc.push_back(top);
+  } while (top != foo);
+  std::reverse(scc.begin(), scc.end());
+  sccs.push_back(scc);
+}
+
+std::vector<Function *> CallGraph::getBottomUpOrder() {
+  std::vector<Function *> order;
+  for (auto &scc : sccs)
+    order.insert(order.end(), scc.begin(), scc.end());
+  return order;
+}
+
+bool CallGraph::inSameSCC(Function *foo1, Function *foo2) {
+  auto iter1 = sccOf.find(foo1), iter2 = sccOf.find(foo2);
+  return iter1 != sccOf.end() && iter2 != sccOf.end() &&
+         iter1->second == iter2->second;
+}
+
+bool CallGraph::isRecursive(Function *foo) {
+  auto iter = sccOf.find(foo);
+  if (iter == sccOf.end())
+    return false;
+  auto &callees = calleesOf[foo];
+  return sccs[iter->second].size() > 1 ||
+         std::find(callees.begin(), callees.end(), foo) != callees.end();
+}
+
+void CallGraph::forEachSCC(
+    const std::function<void(const std::vector<Function *> &)> &visit) {
+  for (auto &scc : sccs)
+    visit(scc);
+}
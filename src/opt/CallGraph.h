@@ -0,0 +1,36 @@
+#ifndef CALLGRAPHH
+#define CALLGRAPHH
+
+#include "BasicOperation.h"
+#include <functional>
+
+// 调用图：由 call 指令的被调函数操作数构造，只包含有函数体的函数。
+// 强连通分量按自底向上的顺序排列，即被调函数所在的分量在调用者之前，
+// 同一分量内的函数互相递归。
+class CallGraph {
+  std::map<Function *, std::vector<Function *>> calleesOf, callersOf;
+  std::map<Function *, int> sccOf;
+  std::vector<std::vector<Function *>> sccs;
+  // Tarjan 算法的状态
+  std::map<Function *, int> dfn, low;
+  std::vector<Function *> stack;
+  std::set<Function *> onStack;
+
+  void tarjan(Function *foo);
+
+public:
+  explicit CallGraph(Module *m);
+  std::vector<Function *> &getCallees(Function *foo) { return calleesOf[foo]; }
+  std::vector<Function *> &getCallers(Function *foo) { return callersOf[foo]; }
+  const std::vector<std::vector<Function *>> &getSCCs() { return sccs; }
+  // 按分量自底向上排列的全部函数
+  std::vector<Function *> getBottomUpOrder();
+  bool inSameSCC(Function *foo1, Function *foo2);
+  // 函数直接或间接调用自身
+  bool isRecursive(Function *foo);
+  // 自底向上依次处理每个分量：处理一个分量时，它调用的其他分量都已处理完毕
+  void forEachSCC(
+      const std::function<void(const std::vector<Function *> &)> &visit);
+};
+
+#endif // !CALLGRAPHH
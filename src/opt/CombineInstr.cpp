@@ -1,11 +1,9 @@
 #include "CombineInstr.h"
 #include <unordered_map>
 
-void CombineInstr::execute() {
-  for (auto foo : m->function_list_)
-    if (!foo->basic_blocks_.empty())
-      for (BasicBlock *bb : foo->basic_blocks_)
-        checkBlock(bb);
+void CombineInstr::runOnFunction(Function *foo) {
+  for (BasicBlock *bb : foo->basic_blocks_)
+    checkBlock(bb);
 }
 
 void CombineInstr::checkBlock(BasicBlock *bb) {
@@ -76,8 +74,7 @@ void CombineInstr::checkBlock(BasicBlock *bb) {
       }
       if (!dupTime)
         continue;
-      ConstantInt *dupTimeConst =
-          new ConstantInt(instr->parent_->parent_->parent_->int32_ty_, dupTime);
+      ConstantInt *dupTimeConst = m->get_const_int(m->int32_ty_, dupTime);
       Instruction *toMulInst = new BinaryInst(
           bb->parent_->parent_->int32_ty_, Instruction::Mul,
           static_cast<Value *>(EndInstr), dupTimeConst, bb, true);
@@ -2,11 +2,12 @@
 #define COMBINEINSTRH
 #include "opt.h"
 
-class CombineInstr : public Optimization {
+class CombineInstr : public FunctionPass {
 
 public:
-    CombineInstr(Module *m) : Optimization(m) {}
-    void execute();
+    CombineInstr(Module *m) : FunctionPass(m) {}
+    void runOnFunction(Function *foo);
+    int preserved() { return ALL_ANALYSIS; }
     void checkBlock(BasicBlock *bb);
 };
 
@@ -1,31 +1,32 @@
 #include "ConstSpread.h"
+#include "utils.h"
 
 ConstantInt *ConstSpread::CalcInt(Instruction::OpID op, ConstantInt *v1,
                                   ConstantInt *v2) {
   int a = v1->value_, b = v2->value_;
   switch (op) {
   case Instruction::Add:
-    return new ConstantInt(m->int32_ty_, a + b);
+    return m->get_const_int(m->int32_ty_, a + b);
   case Instruction::Sub:
-    return new ConstantInt(m->int32_ty_, a - b);
+    return m->get_const_int(m->int32_ty_, a - b);
   case Instruction::Mul:
-    return new ConstantInt(m->int32_ty_, a * b);
+    return m->get_const_int(m->int32_ty_, a * b);
   case Instruction::SDiv:
-    return new ConstantInt(m->int32_ty_, a / b);
+    return m->get_const_int(m->int32_ty_, a / b);
   case Instruction::SRem:
-    return new ConstantInt(m->int32_ty_, a % b);
+    return m->get_const_int(m->int32_ty_, a % b);
   case Instruction::Shl:
-    return new ConstantInt(m->int32_ty_, a << b);
+    return m->get_const_int(m->int32_ty_, a << b);
   case Instruction::LShr:
-    return new ConstantInt(m->int32_ty_, (unsigned)a >> b);
+    return m->get_const_int(m->int32_ty_, (unsigned)a >> b);
   case Instruction::AShr:
-    return new ConstantInt(m->int32_ty_, a >> b);
+    return m->get_const_int(m->int32_ty_, a >> b);
   case Instruction::And:
-    return new ConstantInt(m->int32_ty_, a & b);
+    return m->get_const_int(m->int32_ty_, a & b);
   case Instruction::Or:
-    return new ConstantInt(m->int32_ty_, a | b);
+    return m->get_const_int(m->int32_ty_, a | b);
   case Instruction::Xor:
-    return new ConstantInt(m->int32_ty_, a ^ b);
+    return m->get_const_int(m->int32_ty_, a ^ b);
   default:
     return nullptr;
   }
@@ -36,13 +37,13 @@ ConstantFloat *ConstSpread::CalcFloat(Instruction::OpID op, ConstantFloat *v1,
   float a = v1->value_, b = v2->value_;
   switch (op) {
   case Instruction::FAdd:
-    return new ConstantFloat(m->float32_ty_, a + b);
+    return m->get_const_float(a + b);
   case Instruction::FSub:
-    return new ConstantFloat(m->float32_ty_, a - b);
+    return m->get_const_float(a - b);
   case Instruction::FMul:
-    return new ConstantFloat(m->float32_ty_, a * b);
+    return m->get_const_float(a * b);
   case Instruction::FDiv:
-    return new ConstantFloat(m->float32_ty_, a / b);
+    return m->get_const_float(a / b);
   default:
     return nullptr;
   }
@@ -54,25 +55,25 @@ ConstantInt *ConstSpread::CalcICMP(ICmpInst::ICmpOp op, ConstantInt *v1,
   int rhs = v2->value_;
   switch (op) {
   case ICmpInst::ICMP_EQ:
-    return new ConstantInt(m->int1_ty_, lhs == rhs);
+    return m->get_const_int(m->int1_ty_, lhs == rhs);
   case ICmpInst::ICMP_NE:
-    return new ConstantInt(m->int1_ty_, lhs != rhs);
+    return m->get_const_int(m->int1_ty_, lhs != rhs);
   case ICmpInst::ICMP_SGT:
-    return new ConstantInt(m->int1_ty_, lhs > rhs);
+    return m->get_const_int(m->int1_ty_, lhs > rhs);
   case ICmpInst::ICMP_SGE:
-    return new ConstantInt(m->int1_ty_, lhs >= rhs);
+    return m->get_const_int(m->int1_ty_, lhs >= rhs);
   case ICmpInst::ICMP_SLE:
-    return new ConstantInt(m->int1_ty_, lhs <= rhs);
+    return m->get_const_int(m->int1_ty_, lhs <= rhs);
   case ICmpInst::ICMP_SLT:
-    return new ConstantInt(m->int1_ty_, lhs < rhs);
+    return m->get_const_int(m->int1_ty_, lhs < rhs);
   case ICmpInst::ICMP_UGE:
-    return new ConstantInt(m->int1_ty_, (unsigned)lhs >= (unsigned)rhs);
+    return m->get_const_int(m->int1_ty_, (unsigned)lhs >= (unsigned)rhs);
   case ICmpInst::ICMP_ULE:
-    return new ConstantInt(m->int1_ty_, (unsigned)lhs <= (unsigned)rhs);
+    return m->get_const_int(m->int1_ty_, (unsigned)lhs <= (unsigned)rhs);
   case ICmpInst::ICMP_ULT:
-    return new ConstantInt(m->int1_ty_, (unsigned)lhs < (unsigned)rhs);
+    return m->get_const_int(m->int1_ty_, (unsigned)lhs < (unsigned)rhs);
   case ICmpInst::ICMP_UGT:
-    return new ConstantInt(m->int1_ty_, (unsigned)lhs > (unsigned)rhs);
+    return m->get_const_int(m->int1_ty_, (unsigned)lhs > (unsigned)rhs);
   default:
     return nullptr;
   }
@@ -83,50 +84,45 @@ ConstantInt *ConstSpread::CalcFCMP(FCmpInst::FCmpOp op, ConstantFloat *v1,
   float rhs = v2->value_;
   switch (op) {
   case FCmpInst::FCMP_UEQ:
-    return new ConstantInt(m->int1_ty_, lhs == rhs);
+    return m->get_const_int(m->int1_ty_, lhs == rhs);
   case FCmpInst::FCMP_UNE:
-    return new ConstantInt(m->int1_ty_, lhs != rhs);
+    return m->get_const_int(m->int1_ty_, lhs != rhs);
   case FCmpInst::FCMP_UGT:
-    return new ConstantInt(m->int1_ty_, lhs > rhs);
+    return m->get_const_int(m->int1_ty_, lhs > rhs);
   case FCmpInst::FCMP_UGE:
-    return new ConstantInt(m->int1_ty_, lhs >= rhs);
+    return m->get_const_int(m->int1_ty_, lhs >= rhs);
   case FCmpInst::FCMP_ULE:
-    return new ConstantInt(m->int1_ty_, lhs <= rhs);
+    return m->get_const_int(m->int1_ty_, lhs <= rhs);
   case FCmpInst::FCMP_ULT:
-    return new ConstantInt(m->int1_ty_, lhs < rhs);
+    return m->get_const_int(m->int1_ty_, lhs < rhs);
   case FCmpInst::FCMP_FALSE:
-    return new ConstantInt(m->int1_ty_, 0);
+    return m->get_const_int(m->int1_ty_, 0);
   case FCmpInst::FCMP_TRUE:
-    return new ConstantInt(m->int1_ty_, 1);
+    return m->get_const_int(m->int1_ty_, 1);
   case FCmpInst::FCMP_OEQ:
-    return new ConstantInt(m->int1_ty_, lhs == rhs);
+    return m->get_const_int(m->int1_ty_, lhs == rhs);
   case FCmpInst::FCMP_ONE:
-    return new ConstantInt(m->int1_ty_, lhs != rhs);
+    return m->get_const_int(m->int1_ty_, lhs != rhs);
   case FCmpInst::FCMP_OGE:
-    return new ConstantInt(m->int1_ty_, lhs >= rhs);
+    return m->get_const_int(m->int1_ty_, lhs >= rhs);
   case FCmpInst::FCMP_OGT:
-    return new ConstantInt(m->int1_ty_, lhs > rhs);
+    return m->get_const_int(m->int1_ty_, lhs > rhs);
   case FCmpInst::FCMP_OLE:
-    return new ConstantInt(m->int1_ty_, lhs <= rhs);
+    return m->get_const_int(m->int1_ty_, lhs <= rhs);
   case FCmpInst::FCMP_OLT:
-    return new ConstantInt(m->int1_ty_, lhs < rhs);
+    return m->get_const_int(m->int1_ty_, lhs < rhs);
   default:
     return nullptr;
   }
 }
 
-void ConstSpread::execute() {
-  assert(m != nullptr);
-  for (Function *foo : m->function_list_) {
-    if (foo->basic_blocks_.size()) {
-      bool change = true;
-      while (change) {
-        change = false;
-        change |= SpreadingConst(foo);
-        change |= BranchProcess(foo);
-        DeleteUnusedBB(foo);
-      }
-    }
+void ConstSpread::runOnFunction(Function *foo) {
+  bool change = true;
+  while (change) {
+    change = false;
+    change |= SpreadingConst(foo);
+    change |= BranchProcess(foo);
+    DeleteUnusedBB(foo);
   }
 }
 
@@ -206,7 +202,7 @@ bool ConstSpread::SpreadingConst(Function *func) {
         testConstFloata = dynamic_cast<ConstantFloat *>(instr->get_operand(0));
         if (testConstFloata) {
           instr->replace_all_use_with(
-              new ConstantFloat(m->float32_ty_, -testConstFloata->value_));
+              m->get_const_float(-testConstFloata->value_));
           uselessInstr[instr] = bb;
         }
         break;
@@ -214,7 +210,7 @@ bool ConstSpread::SpreadingConst(Function *func) {
         testConstFloata = dynamic_cast<ConstantFloat *>(instr->get_operand(0));
         if (testConstFloata) {
           instr->replace_all_use_with(
-              new ConstantInt(m->int32_ty_, testConstFloata->value_));
+              m->get_const_int(m->int32_ty_, testConstFloata->value_));
           uselessInstr[instr] = bb;
         }
         break;
@@ -222,7 +218,7 @@ bool ConstSpread::SpreadingConst(Function *func) {
         testConstInta = dynamic_cast<ConstantInt *>(instr->get_operand(0));
         if (testConstInta) {
           instr->replace_all_use_with(
-              new ConstantFloat(m->float32_ty_, testConstInta->value_));
+              m->get_const_float(testConstInta->value_));
           uselessInstr[instr] = bb;
         }
         break;
@@ -230,7 +226,7 @@ bool ConstSpread::SpreadingConst(Function *func) {
         testConstInta = dynamic_cast<ConstantInt *>(instr->get_operand(0));
         if (testConstInta) {
           instr->replace_all_use_with(
-              new ConstantInt(m->int32_ty_, testConstInta->value_));
+              m->get_const_int(m->int32_ty_, testConstInta->value_));
           uselessInstr[instr] = bb;
         }
         break;
@@ -306,6 +302,7 @@ bool ConstSpread::SpreadingConst(Function *func) {
     }
   }
   if (!uselessInstr.empty()) {
+    addStat("const-spread.folded-instrs", uselessInstr.size());
     for (auto [instr, bb] : uselessInstr)
       bb->delete_instr(instr);
     return true;
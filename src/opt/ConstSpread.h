@@ -4,10 +4,10 @@
 #include "BasicOperation.h"
 #include "opt.h"
 
-class ConstSpread : public Optimization {
+class ConstSpread : public FunctionPass {
 public:
-  ConstSpread(Module *m_) : Optimization(m_) {}
-  void execute();
+  ConstSpread(Module *m_) : FunctionPass(m_) {}
+  void runOnFunction(Function *foo);
   ConstantInt *CalcInt(Instruction::OpID op, ConstantInt *v1, ConstantInt *v2);
   ConstantFloat *CalcFloat(Instruction::OpID op, ConstantFloat *v1,
                            ConstantFloat *v2);
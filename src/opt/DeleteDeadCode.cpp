@@ -1,29 +1,7 @@
 #include "DeleteDeadCode.h"
 #include "ConstSpread.h"
+#include "utils.h"
 
-std::set<std::string> OptFunc = {"getint",          "getfloat",
-                                 "getch",           "getarray",
-                                 "getfarray",       "putint",
-                                 "putfloat",        "putch",
-                                 "putarray",        "putfarray",
-                                 "_sysy_starttime", "_sysy_stoptime",
-                                 "memcpy",          "memclr",
-                                 "memset",          "llvm.memset.p0.i32",
-                                 "__aeabi_memcpy4", "__aeabi_memclr4",
-                                 "__aeabi_memset4"};
-
-void DeadCodeDeletion::initFuncPtrArg() {
-  for (auto foo : m->function_list_) {
-    if (foo->basic_blocks_.empty())
-      continue;
-    for (auto arg : foo->arguments_)
-      if (arg->type_->tid_ == Type::PointerTyID) {
-        if (!funcPtrArgs.count(foo))
-          funcPtrArgs[foo] = {};
-        funcPtrArgs[foo].insert(arg);
-      }
-  }
-}
 void DeadCodeDeletion::Init(Function *foo) {
   storePos.clear();
   for (auto bb : foo->basic_blocks_) {
@@ -34,16 +12,6 @@ void DeadCodeDeletion::Init(Function *foo) {
           storePos.insert({ins->get_operand(1), {}});
         }
         storePos[ins->get_operand(1)].push_back(ins);
-        if (dynamic_cast<GlobalVariable *>(ins->get_operand(1)))
-          OptFunc.insert(foo->name_);
-        if (dynamic_cast<GetElementPtrInst *>(ins->get_operand(1)))
-          OptFunc.insert(foo->name_);
-        if (funcPtrArgs[foo].count(ins->get_operand(1)))
-          OptFunc.insert(foo->name_);
-      } else if (ins->op_id_ == Instruction::Call) {
-        auto f = ins->get_operand(ins->operands_.size() - 1);
-        if (OptFunc.count(f->name_))
-          OptFunc.insert(foo->name_);
       }
     }
   }
@@ -53,16 +21,12 @@ bool DeadCodeDeletion::checkOpt(Function *foo, Instruction *ins) {
     exitBlock = ins->parent_;
     return true;
   } else if (ins->op_id_ == Instruction::Call) {
-    auto f = ins->get_operand(ins->operands_.size() - 1);
-    return OptFunc.count(f->name_);
+    return !info->getCallEffect(ins).noSideEffect();
   } else if (ins->op_id_ == Instruction::Store) {
-    if (dynamic_cast<GlobalVariable *>(ins->get_operand(1)))
-      return true;
-    if (dynamic_cast<GetElementPtrInst *>(ins->get_operand(1)))
-      return true;
-    if (funcPtrArgs[foo].count(ins->get_operand(1)))
-      return true;
-    return false;
+    // 只有直接写入局部 alloca 的 store 在该 alloca 被使用时才保留（见
+    // storePos）；全局变量、形参、getelementptr 与指针 phi 等地址可能经由
+    // 其他指针被读取，一律保留
+    return !dynamic_cast<AllocaInst *>(ins->get_operand(1));
   }
   return false;
 }
@@ -160,21 +124,17 @@ void DeadCodeDeletion::deleteInstr(Function *foo) {
       }
     }
     deleteCnt += ins2Del.size();
+    addStat("dce.deleted-instrs", ins2Del.size());
     for (auto ins : ins2Del) {
       bb->delete_instr(ins);
     }
   }
 }
 
-void DeadCodeDeletion::execute() {
-  ReverseDomainTree reverseDomainTree(m);
-  reverseDomainTree.execute();
-  initFuncPtrArg();
-  for (auto foo : m->function_list_)
-    if (!foo->basic_blocks_.empty()) {
-      Init(foo);
-      findInstr(foo);
-      deleteInstr(foo);
-      DeleteUnusedBB(foo);
-    }
+void DeadCodeDeletion::runOnFunction(Function *foo) {
+  requireAnalysis(foo, POST_DOMINATOR);
+  Init(foo);
+  findInstr(foo);
+  deleteInstr(foo);
+  DeleteUnusedBB(foo);
 }
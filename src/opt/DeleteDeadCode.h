@@ -1,21 +1,21 @@
 #ifndef DELETEDEADCODEH
 #define DELETEDEADCODEH
 
-#include "opt.h"
+#include "FuncInfo.h"
 
 extern std::set<std::string> sysLibFunc;
 
-class DeadCodeDeletion : public Optimization {
-  std::map<Function *, std::set<Value *>> funcPtrArgs;
+class DeadCodeDeletion : public FunctionPass {
   std::map<Value *, std::vector<Value *>> storePos;
   BasicBlock *exitBlock;
   std::set<Instruction *> uselessInstr;
   std::set<BasicBlock *> uselessBlock;
 
 public:
-  DeadCodeDeletion(Module *m) : Optimization(m), exitBlock(nullptr) {}
-  void execute();
-  void initFuncPtrArg();
+  DeadCodeDeletion(Module *m) : FunctionPass(m), exitBlock(nullptr) {}
+  void runOnFunction(Function *foo);
+  int required() { return POST_DOMINATOR; }
+  int requiredModule() { return FUNC_INFO; }
   void Init(Function *foo);
   bool checkOpt(Function *foo, Instruction *instr);
   void findInstr(Function *foo);
@@ -0,0 +1,84 @@
+#include "FuncInfo.h"
+#include "AliasAnalysis.h"
+#include "CallGraph.h"
+
+// 只进行输入输出、或只读写指针实参所指内存的库函数，其余声明视为读写一切
+static const std::set<std::string> ioFunc = {
+    "getint",    "getch",     "getfloat",        "getarray",
+    "getfarray", "putint",    "putch",           "putfloat",
+    "putarray",  "putfarray", "_sysy_starttime", "_sysy_stoptime"};
+static const std::set<std::string> readArgFunc = {"putarray", "putfarray",
+                                                  "__aeabi_memcpy4"};
+static const std::set<std::string> writeArgFunc = {
+    "getarray",        "getfarray",       "__aeabi_memcpy4",
+    "__aeabi_memclr4", "__aeabi_memset4", "llvm.memset.p0.i32"};
+
+FuncInfo::FuncInfo(Module *m) {
+  // 自定义函数的摘要从空开始，此后只会增大
+  for (auto foo : m->function_list_) {
+    auto &effect = effects[foo];
+    if (!foo->basic_blocks_.empty())
+      continue;
+    auto &name = foo->name_;
+    if (ioFunc.count(name) || readArgFunc.count(name) ||
+        writeArgFunc.count(name)) {
+      effect.io = ioFunc.count(name);
+      effect.readArg = readArgFunc.count(name);
+      effect.writeArg = writeArgFunc.count(name);
+    } else
+      effect = {true, true, true, true, true};
+  }
+  // 自底向上处理调用图的分量，分量内互相递归的函数的摘要只会增大，
+  // 重新计算到不再变化即可
+  CallGraph(m).forEachSCC([&](const std::vector<Function *> &scc) {
+    for (bool changed = true; changed;) {
+      changed = false;
+      for (auto foo : scc) {
+        auto effect = computeEffect(foo);
+        auto &old = effects[foo];
+        if (effect.readGlobal != old.readGlobal ||
+            effect.writeGlobal != old.writeGlobal ||
+            effect.readArg != old.readArg || effect.writeArg != old.writeArg ||
+            effect.io != old.io) {
+          old = effect;
+          changed = true;
+        }
+      }
+    }
+  });
+}
+
+void FuncInfo::addAccess(FuncEffect &effect, Value *ptr, bool read,
+                         bool write) {
+  auto base = getBasePtr(ptr);
+  if (dynamic_cast<AllocaInst *>(base))
+    return;
+  bool global = !dynamic_cast<Argument *>(base);
+  bool arg = !dynamic_cast<GlobalVariable *>(base);
+  effect.readGlobal |= read && global;
+  effect.writeGlobal |= write && global;
+  effect.readArg |= read && arg;
+  effect.writeArg |= write && arg;
+}
+
+FuncEffect FuncInfo::computeEffect(Function *foo) {
+  FuncEffect effect;
+  for (auto bb : foo->basic_blocks_)
+    for (auto instr : bb->instr_list_) {
+      if (instr->is_load())
+        addAccess(effect, instr->get_operand(0), true, false);
+      else if (instr->is_store())
+        addAccess(effect, instr->get_operand(1), false, true);
+      else if (instr->is_call()) {
+        auto &callee = getCallEffect(instr);
+        effect.readGlobal |= callee.readGlobal;
+        effect.writeGlobal |= callee.writeGlobal;
+        effect.io |= callee.io;
+        for (int i = 0; i + 1 < instr->num_ops_; i++)
+          if (instr->get_operand(i)->type_->tid_ == Type::PointerTyID)
+            addAccess(effect, instr->get_operand(i), callee.readArg,
+                      callee.writeArg);
+      }
+    }
+  return effect;
+}
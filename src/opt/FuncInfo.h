@@ -0,0 +1,42 @@
+#ifndef FUNCINFOH
+#define FUNCINFOH
+
+#include "BasicOperation.h"
+
+// 函数的副作用摘要，局部数组的读写不计入
+struct FuncEffect {
+  bool readGlobal = false;  // 读取全局变量
+  bool writeGlobal = false; // 写入全局变量
+  bool readArg = false;     // 通过指针形参读取内存
+  bool writeArg = false;    // 通过指针形参写入内存
+  bool io = false;          // 调用 sylib 中的输入输出函数
+
+  bool readMemory() { return readGlobal || readArg; }
+  bool writeMemory() { return writeGlobal || writeArg; }
+  // 结果未被使用时调用可以删除
+  bool noSideEffect() { return !writeMemory() && !io; }
+  // 结果只由实参的值决定，相同实参的调用可以合并
+  bool pure() { return noSideEffect() && !readMemory(); }
+};
+
+// 过程间副作用分析：库函数的摘要预先给定，自定义函数的摘要由自身的访存
+// 与所调用函数的摘要合并得到，按调用图的强连通分量自底向上计算。
+// 通过指针实参的读写按实参所指对象归入全局变量、形参或局部数组。
+class FuncInfo {
+  std::map<Function *, FuncEffect> effects;
+
+  // 将 callee 通过 ptr 的读写合并到 effect
+  void addAccess(FuncEffect &effect, Value *ptr, bool read, bool write);
+  FuncEffect computeEffect(Function *foo);
+
+public:
+  explicit FuncInfo(Module *m);
+  // 构造后只读，可在多个线程中同时查询
+  FuncEffect &getEffect(Function *foo) { return effects.at(foo); }
+  FuncEffect &getCallEffect(Instruction *call) {
+    return effects.at(
+        static_cast<Function *>(call->get_operand(call->num_ops_ - 1)));
+  }
+};
+
+#endif // !FUNCINFOH
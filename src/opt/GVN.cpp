@@ -0,0 +1,99 @@
+#include "GVN.h"
+#include "utils.h"
+#include <algorithm>
+
+void GVN::runOnFunction(Function *foo) {
+  requireAnalysis(foo, DOMINATOR);
+  available.clear();
+  domChildren.clear();
+  deleteCnt = 0;
+  auto entry = foo->basic_blocks_.front();
+  for (auto bb : foo->basic_blocks_)
+    if (bb != entry)
+      domChildren[bb->idom_].push_back(bb);
+  runOnBlock(entry);
+  addStat("gvn.deleted-instrs", deleteCnt);
+}
+
+void GVN::runOnBlock(BasicBlock *bb) {
+  std::vector<Key> inserted;
+  std::vector<Instruction *> uselessInstr;
+  for (auto instr : bb->instr_list_) {
+    Key key;
+    if (!getKey(instr, key))
+      continue;
+    auto iter = available.find(key);
+    if (iter != available.end()) {
+      instr->replace_all_use_with(iter->second);
+      uselessInstr.push_back(instr);
+    } else {
+      available[key] = instr;
+      inserted.push_back(key);
+    }
+  }
+  for (auto instr : uselessInstr)
+    bb->delete_instr(instr);
+  deleteCnt += uselessInstr.size();
+  for (auto child : domChildren[bb])
+    runOnBlock(child);
+  // 离开支配树子树时撤销本块加入的表项
+  for (auto &key : inserted)
+    available.erase(key);
+}
+
+bool GVN::getKey(Instruction *instr, Key &key) {
+  bool commutative = false;
+  switch (instr->op_id_) {
+  case Instruction::Add:
+  case Instruction::Mul:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+  case Instruction::FAdd:
+  case Instruction::FMul:
+    commutative = true;
+    break;
+  case Instruction::Sub:
+  case Instruction::SDiv:
+  case Instruction::SRem:
+  case Instruction::UDiv:
+  case Instruction::URem:
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+  case Instruction::FSub:
+  case Instruction::FDiv:
+  case Instruction::FNeg:
+  case Instruction::GetElementPtr:
+  case Instruction::ZExt:
+  case Instruction::FPtoSI:
+  case Instruction::SItoFP:
+  case Instruction::BitCast:
+  case Instruction::FCmp:
+    break;
+  case Instruction::Call:
+    if (!info->getCallEffect(instr).pure())
+      return false;
+    break;
+  case Instruction::ICmp: {
+    auto op = static_cast<ICmpInst *>(instr)->icmp_op_;
+    commutative = op == ICmpInst::ICMP_EQ || op == ICmpInst::ICMP_NE;
+  } break;
+  default:
+    return false;
+  }
+  key.push_back(instr->op_id_);
+  key.push_back(reinterpret_cast<uintptr_t>(instr->type_));
+  if (instr->is_cmp())
+    key.push_back(static_cast<ICmpInst *>(instr)->icmp_op_);
+  else if (instr->is_fcmp())
+    key.push_back(static_cast<FCmpInst *>(instr)->fcmp_op_);
+  // 常量在 Module 中唯一化，操作数统一按对象编号
+  std::vector<uintptr_t> ops;
+  for (auto op : instr->operands_)
+    ops.push_back(reinterpret_cast<uintptr_t>(op));
+  if (commutative)
+    std::sort(ops.begin(), ops.end());
+  key.insert(key.end(), ops.begin(), ops.end());
+  return true;
+}
@@ -0,0 +1,26 @@
+#ifndef GVNH
+#define GVNH
+
+#include "FuncInfo.h"
+
+// 基于支配树作用域的值编号：沿支配树先序遍历，
+// 以操作码与操作数为键记录纯计算指令（包括纯函数的调用），
+// 被支配的重复计算替换为先前的结果。
+class GVN : public FunctionPass {
+  typedef std::vector<uintptr_t> Key;
+  std::map<Key, Instruction *> available;
+  std::map<BasicBlock *, std::vector<BasicBlock *>> domChildren;
+  int deleteCnt;
+
+public:
+  GVN(Module *m) : FunctionPass(m) {}
+  void runOnFunction(Function *foo);
+  int required() { return DOMINATOR; }
+  int requiredModule() { return FUNC_INFO; }
+  int preserved() { return ALL_ANALYSIS; }
+  void runOnBlock(BasicBlock *bb);
+  // 指令不可编号（有副作用或读写内存）时返回 false
+  bool getKey(Instruction *instr, Key &key);
+};
+
+#endif // !GVNH
@@ -0,0 +1,365 @@
+#include "InductionVariable.h"
+#include "utils.h"
+#include <climits>
+
+void InductionVariable::runOnFunction(Function *foo) {
+  reducedCnt = replacedCnt = deletedCnt = 0;
+  requireAnalysis(foo, LOOP_INFO);
+  bool cfgChanged = false;
+  // 内层循环在前：内层前置块中的起始地址还可以被外层循环削弱
+  auto loops = foo->loops_;
+  for (auto iter = loops.rbegin(); iter != loops.rend(); iter++) {
+    loop = *iter;
+    if (loop->latches.size() != 1)
+      continue;
+    preheader = loop->getPreheader();
+    if (preheader == nullptr) {
+      preheader = LoopInfo(m).insertPreheader(loop);
+      if (preheader == nullptr)
+        continue;
+      cfgChanged = true;
+    }
+    runOnLoop();
+  }
+  if (cfgChanged)
+    invalidateAnalysis(foo);
+  addStat("indvars.reduced-geps", reducedCnt);
+  addStat("indvars.replaced-exit-tests", replacedCnt);
+  addStat("indvars.deleted-ivs", deletedCnt);
+}
+
+void InductionVariable::runOnLoop() {
+  for (auto iv : findBasicIVs()) {
+    auto ptrs = strengthReduce(iv);
+    replaceExitTest(iv, ptrs);
+    deleteDeadIV(iv);
+  }
+}
+
+bool InductionVariable::isInvariant(Value *val) {
+  auto instr = dynamic_cast<Instruction *>(val);
+  return instr == nullptr || !loop->contains(instr->parent_);
+}
+
+std::vector<InductionVariable::BasicIV> InductionVariable::findBasicIVs() {
+  std::vector<BasicIV> ivs;
+  auto latch = loop->latches.front();
+  for (auto instr : loop->header->instr_list_) {
+    if (!instr->is_phi())
+      break;
+    if (instr->type_->tid_ != Type::IntegerTyID || instr->num_ops_ != 4)
+      continue;
+    BasicIV iv{instr, nullptr, nullptr, 0};
+    for (int i = 0; i < 4; i += 2)
+      if (instr->get_operand(i + 1) == preheader)
+        iv.init = instr->get_operand(i);
+      else if (instr->get_operand(i + 1) == latch)
+        iv.next = dynamic_cast<Instruction *>(instr->get_operand(i));
+    if (iv.init == nullptr || iv.next == nullptr ||
+        (iv.next->op_id_ != Instruction::Add &&
+         iv.next->op_id_ != Instruction::Sub))
+      continue;
+    auto lhs = iv.next->get_operand(0), rhs = iv.next->get_operand(1);
+    if (iv.next->op_id_ == Instruction::Add && lhs != instr)
+      std::swap(lhs, rhs);
+    auto step = dynamic_cast<ConstantInt *>(rhs);
+    if (lhs != instr || step == nullptr || step->value_ == 0)
+      continue;
+    iv.step =
+        iv.next->op_id_ == Instruction::Add ? step->value_ : -step->value_;
+    ivs.push_back(iv);
+  }
+  return ivs;
+}
+
+bool InductionVariable::getAffine(Value *val, BasicIV &iv, Affine &aff) {
+  aff = Affine();
+  if (val == iv.phi) {
+    aff.scale = 1;
+    return true;
+  }
+  if (auto cval = dynamic_cast<ConstantInt *>(val)) {
+    aff.offset = cval->value_;
+    return true;
+  }
+  if (isInvariant(val)) {
+    aff.inv = val;
+    return true;
+  }
+  auto instr = static_cast<Instruction *>(val);
+  Affine lhs, rhs;
+  if ((instr->op_id_ != Instruction::Add && instr->op_id_ != Instruction::Sub &&
+       instr->op_id_ != Instruction::Mul) ||
+      !getAffine(instr->get_operand(0), iv, lhs) ||
+      !getAffine(instr->get_operand(1), iv, rhs))
+    return false;
+  switch (instr->op_id_) {
+  case Instruction::Add:
+    if (lhs.inv && rhs.inv)
+      return false;
+    aff.scale = lhs.scale + rhs.scale;
+    aff.offset = lhs.offset + rhs.offset;
+    aff.inv = lhs.inv ? lhs.inv : rhs.inv;
+    return true;
+  case Instruction::Sub:
+    if (rhs.inv)
+      return false;
+    aff.scale = lhs.scale - rhs.scale;
+    aff.offset = lhs.offset - rhs.offset;
+    aff.inv = lhs.inv;
+    return true;
+  default:
+    // 只处理与常量相乘
+    if (lhs.scale || lhs.inv)
+      std::swap(lhs, rhs);
+    if (lhs.scale || lhs.inv || rhs.inv)
+      return false;
+    aff.scale = rhs.scale * lhs.offset;
+    aff.offset = rhs.offset * lhs.offset;
+    return true;
+  }
+}
+
+Instruction *InductionVariable::moveToPreheader(Instruction *instr) {
+  instr->parent_->remove_instr(instr);
+  preheader->add_instruction_before_terminator(instr);
+  return instr;
+}
+
+Value *InductionVariable::expand(const Affine &aff, Value *val) {
+  auto i32 = m->int32_ty_;
+  Value *res = nullptr;
+  int offset = aff.offset;
+  if (auto cval = dynamic_cast<ConstantInt *>(val))
+    offset += aff.scale * cval->value_;
+  else if (aff.scale != 0) {
+    res = val;
+    if (aff.scale != 1)
+      res = moveToPreheader(new BinaryInst(i32, Instruction::Mul, res,
+                                           m->get_const_int(i32, aff.scale),
+                                           preheader));
+  }
+  if (aff.inv)
+    res = res ? moveToPreheader(new BinaryInst(i32, Instruction::Add, res,
+                                               aff.inv, preheader))
+              : aff.inv;
+  if (res == nullptr)
+    return m->get_const_int(i32, offset);
+  if (offset != 0)
+    res = moveToPreheader(new BinaryInst(
+        i32, Instruction::Add, res, m->get_const_int(i32, offset), preheader));
+  return res;
+}
+
+// 类型占用的字节数
+static long long typeSize(Type *ty) {
+  if (ty->tid_ != Type::ArrayTyID)
+    return 4;
+  auto arrTy = static_cast<ArrayType *>(ty);
+  return arrTy->num_elements_ * typeSize(arrTy->contained_);
+}
+
+static bool fitsInt(long long val) { return val >= INT_MIN && val <= INT_MAX; }
+
+bool InductionVariable::fitsOffset(Value *ptr,
+                                   const std::vector<Value *> &idxs) {
+  auto ty = static_cast<PointerType *>(ptr->type_)->contained_;
+  long long offset = 0;
+  for (int i = 0; i < idxs.size(); i++) {
+    if (i > 0)
+      ty = static_cast<ArrayType *>(ty)->contained_;
+    if (auto cval = dynamic_cast<ConstantInt *>(idxs[i])) {
+      offset += cval->value_ * typeSize(ty);
+      if (!fitsInt(offset))
+        return false;
+    }
+  }
+  return true;
+}
+
+bool InductionVariable::inRange(const Affine &aff, Value *val) {
+  if (aff.inv)
+    return false;
+  if (auto cval = dynamic_cast<ConstantInt *>(val)) {
+    long long res = (long long)aff.scale * cval->value_ + aff.offset;
+    return fitsInt(res);
+  }
+  // 变量只有原样作为下标时才能确定不溢出
+  return aff.scale == 1 && aff.offset == 0;
+}
+
+std::vector<InductionVariable::ReducedPtr>
+InductionVariable::strengthReduce(BasicIV &iv) {
+  std::vector<GetElementPtrInst *> geps;
+  for (auto bb : loop->blocks)
+    for (auto instr : bb->instr_list_)
+      if (instr->is_gep())
+        geps.push_back(static_cast<GetElementPtrInst *>(instr));
+
+  std::vector<ReducedPtr> ptrs;
+  auto latch = loop->latches.front();
+  for (auto gep : geps) {
+    // 只有一维下标随 iv 变化，其余操作数均为循环不变量
+    int pos = -1;
+    for (int i = 0; i < gep->num_ops_; i++)
+      if (!isInvariant(gep->get_operand(i))) {
+        if (pos != -1 || i == 0) {
+          pos = -1;
+          break;
+        }
+        pos = i;
+      }
+    Affine aff;
+    if (pos == -1 || !getAffine(gep->get_operand(pos), iv, aff) ||
+        aff.scale == 0)
+      continue;
+
+    // 沿支配树从 latch 向上直到循环头，经过 gep 所在块说明每次迭代都会执行
+    bool always = false;
+    for (auto bb = latch; bb && loop->contains(bb); bb = bb->idom_)
+      if (bb == gep->parent_) {
+        always = true;
+        break;
+      }
+
+    // 下标每增加 1，地址增加的结果类型元素个数
+    int factor = 1;
+    auto ty =
+        static_cast<PointerType *>(gep->get_operand(0)->type_)->contained_;
+    for (int i = 1; i + 1 < gep->num_ops_; i++) {
+      if (i >= pos)
+        factor *= static_cast<ArrayType *>(ty)->num_elements_;
+      ty = static_cast<ArrayType *>(ty)->contained_;
+    }
+    // 指针 phi 每次迭代增加的字节数也要能作为 i32 的立即数
+    auto elemSize =
+        typeSize(static_cast<PointerType *>(gep->type_)->contained_);
+    long long stride = (long long)aff.scale * iv.step * factor;
+    if (!fitsInt(stride * elemSize))
+      continue;
+
+    // 形状相同的地址共用一个指针 phi，下标只差常量时在 phi 上加偏移
+    Value *addr = nullptr;
+    for (auto &ptr : ptrs) {
+      bool same = ptr.pos == pos && ptr.aff.scale == aff.scale &&
+                  ptr.aff.inv == aff.inv && ptr.ops.size() == gep->num_ops_;
+      for (int i = 0; same && i < gep->num_ops_; i++)
+        same = i == pos || ptr.ops[i] == gep->get_operand(i);
+      long long delta = ((long long)aff.offset - ptr.aff.offset) * factor;
+      if (!same || !fitsInt(delta * elemSize))
+        continue;
+      addr = ptr.phi;
+      ptr.always |= always;
+      if (delta != 0) {
+        auto offsetGep = new GetElementPtrInst(
+            ptr.phi, {m->get_const_int(m->int32_ty_, delta)}, gep->parent_);
+        gep->parent_->remove_instr(offsetGep);
+        gep->parent_->add_instruction_before_inst(offsetGep, gep);
+        addr = offsetGep;
+      }
+      break;
+    }
+
+    if (addr == nullptr) {
+      std::vector<Value *> idxs;
+      for (int i = 1; i < gep->num_ops_; i++)
+        idxs.push_back(i == pos ? expand(aff, iv.init) : gep->get_operand(i));
+      if (!fitsOffset(gep->get_operand(0), idxs)) {
+        deleteDeadInstr(idxs[pos - 1]);
+        continue;
+      }
+      auto start = moveToPreheader(
+          new GetElementPtrInst(gep->get_operand(0), idxs, preheader));
+      auto phi = PhiInst::create_phi(gep->type_, loop->header);
+      loop->header->add_instruction_front(phi);
+      auto next = new GetElementPtrInst(
+          phi, {m->get_const_int(m->int32_ty_, stride)}, latch);
+      latch->remove_instr(next);
+      latch->add_instruction_before_terminator(next);
+      phi->add_phi_pair_operand(start, preheader);
+      phi->add_phi_pair_operand(next, latch);
+      ptrs.push_back({phi, gep->operands_, pos, aff, always});
+      addr = phi;
+    }
+    gep->replace_all_use_with(addr);
+    auto idx = gep->get_operand(pos);
+    gep->parent_->delete_instr(gep);
+    deleteDeadInstr(idx);
+    reducedCnt++;
+  }
+  return ptrs;
+}
+
+// 循环头以 icmp iv, n 决定是否退出时，改为比较削弱后的指针与 iv 取 n 时的地址。
+// 地址随 iv 严格递增（scale > 0），比较结果不变。
+// 终值地址的下标在前置块中按 i32 计算，后端又将常量下标折算为 i32 的字节偏移，
+// 溢出时比较结果错误，因此要求起止下标及终值地址的字节偏移都不会溢出；
+// 只在条件分支中使用的地址不保证循环中确实访问，不作替换
+void InductionVariable::replaceExitTest(BasicIV &iv,
+                                        std::vector<ReducedPtr> &ptrs) {
+  auto br = loop->header->get_terminator();
+  if (br->num_ops_ != 3)
+    return;
+  auto cmp = dynamic_cast<ICmpInst *>(br->get_operand(0));
+  if (cmp == nullptr || cmp->parent_ != loop->header ||
+      cmp->use_list_.size() != 1)
+    return;
+  auto op = cmp->icmp_op_;
+  auto lhs = cmp->get_operand(0), rhs = cmp->get_operand(1);
+  if (rhs == iv.phi) {
+    static const std::map<ICmpInst::ICmpOp, ICmpInst::ICmpOp> swapped = {
+        {ICmpInst::ICMP_SLT, ICmpInst::ICMP_SGT},
+        {ICmpInst::ICMP_SGT, ICmpInst::ICMP_SLT},
+        {ICmpInst::ICMP_SLE, ICmpInst::ICMP_SGE},
+        {ICmpInst::ICMP_SGE, ICmpInst::ICMP_SLE}};
+    std::swap(lhs, rhs);
+    if (swapped.count(op))
+      op = swapped.at(op);
+  }
+  if (lhs != iv.phi || !isInvariant(rhs) ||
+      (op >= ICmpInst::ICMP_UGT && op <= ICmpInst::ICMP_ULE))
+    return;
+  for (auto &ptr : ptrs) {
+    if (ptr.aff.scale <= 0 || !ptr.always || !inRange(ptr.aff, iv.init) ||
+        !inRange(ptr.aff, rhs))
+      continue;
+    std::vector<Value *> idxs;
+    for (int i = 1; i < ptr.ops.size(); i++)
+      idxs.push_back(i == ptr.pos ? expand(ptr.aff, rhs) : ptr.ops[i]);
+    // 两项检查都通过时终值下标为常量或 rhs 本身，没有新建指令
+    if (!fitsOffset(ptr.ops[0], idxs))
+      continue;
+    auto end = moveToPreheader(
+        new GetElementPtrInst(ptr.ops[0], idxs, preheader));
+    auto newCmp = new ICmpInst(op, ptr.phi, end, loop->header);
+    loop->header->remove_instr(newCmp);
+    loop->header->add_instruction_before_inst(newCmp, cmp);
+    cmp->replace_all_use_with(newCmp);
+    loop->header->delete_instr(cmp);
+    replacedCnt++;
+    return;
+  }
+}
+
+void InductionVariable::deleteDeadIV(BasicIV &iv) {
+  for (auto &use : iv.phi->use_list_)
+    if (use.val_ != iv.next)
+      return;
+  for (auto &use : iv.next->use_list_)
+    if (use.val_ != iv.phi)
+      return;
+  loop->header->delete_instr(iv.phi);
+  iv.next->parent_->delete_instr(iv.next);
+  deletedCnt++;
+}
+
+void InductionVariable::deleteDeadInstr(Value *val) {
+  auto instr = dynamic_cast<Instruction *>(val);
+  if (instr == nullptr || !instr->use_list_.empty() ||
+      !(instr->is_add() || instr->is_sub() || instr->is_mul()))
+    return;
+  std::vector<Value *> ops(instr->operands_.begin(), instr->operands_.end());
+  instr->parent_->delete_instr(instr);
+  for (auto op : ops)
+    deleteDeadInstr(op);
+}
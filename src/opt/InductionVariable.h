@@ -0,0 +1,62 @@
+#ifndef INDUCTIONVARIABLEH
+#define INDUCTIONVARIABLEH
+
+#include "BasicOperation.h"
+#include "LoopInfo.h"
+
+// 归纳变量优化：
+// 1. 识别循环头中形如 i = phi [init, preheader], [i + step, latch] 的基本归纳变量；
+// 2. 下标为 scale * i + offset + inv（inv 为循环不变量）的 getelementptr
+//    改为每次迭代增加固定步长的指针 phi（强度削弱）；
+// 3. 循环条件 i < n 改为比较指针 p < &a[scale * n + ...]（线性函数测试替换），
+//    只在起止下标与地址的字节偏移不会溢出 i32 时进行；
+// 4. 删除只用于自身递增的归纳变量。
+class InductionVariable : public FunctionPass {
+  struct BasicIV {
+    Instruction *phi;
+    Value *init;
+    Instruction *next;
+    int step;
+  };
+  // scale * iv + offset + inv
+  struct Affine {
+    int scale = 0, offset = 0;
+    Value *inv = nullptr;
+  };
+  // 强度削弱得到的指针 phi：第 pos 个操作数换为 aff 时 getelementptr 的地址
+  struct ReducedPtr {
+    Instruction *phi;
+    std::vector<Value *> ops; // 原 getelementptr 的操作数，用于计算终值地址
+    int pos;
+    Affine aff;
+    bool always; // 至少有一个原 getelementptr 每次迭代都会执行
+  };
+  Loop *loop;
+  BasicBlock *preheader;
+  int reducedCnt, replacedCnt, deletedCnt;
+
+public:
+  InductionVariable(Module *m) : FunctionPass(m) {}
+  void runOnFunction(Function *foo);
+  int required() { return LOOP_INFO; }
+  int preserved() { return ALL_ANALYSIS; }
+  void runOnLoop();
+  bool isInvariant(Value *val);
+  std::vector<BasicIV> findBasicIVs();
+  bool getAffine(Value *val, BasicIV &iv, Affine &aff);
+  // 在前置块中计算 aff 在 iv 取 val 时的值
+  Value *expand(const Affine &aff, Value *val);
+  // aff 在 iv 取 val 时的值可以确定不溢出 i32
+  bool inRange(const Affine &aff, Value *val);
+  // 后端将 getelementptr 的常量下标折算为字节后累加成 i32 的立即数，
+  // 返回折算结果是否不溢出
+  bool fitsOffset(Value *ptr, const std::vector<Value *> &idxs);
+  Instruction *moveToPreheader(Instruction *instr);
+  std::vector<ReducedPtr> strengthReduce(BasicIV &iv);
+  void replaceExitTest(BasicIV &iv, std::vector<ReducedPtr> &ptrs);
+  void deleteDeadIV(BasicIV &iv);
+  // 删除不再被使用的纯计算指令及其因此不再被使用的操作数
+  void deleteDeadInstr(Value *val);
+};
+
+#endif // !INDUCTIONVARIABLEH
@@ -0,0 +1,205 @@
+#include "Inline.h"
+#include "utils.h"
+#include <algorithm>
+#include <functional>
+
+// 循环外的调用点允许内联的函数规模，每深一层循环加倍
+const int INLINE_THRESHOLD = 20;
+const int MAX_INLINE_DEPTH = 3;
+// 只有一个调用点的函数内联后原函数可删除，允许更大的规模
+const int SINGLE_SITE_THRESHOLD = 200;
+// 调用者内联后的规模上限，防止代码膨胀
+const int CALLER_SIZE_LIMIT = 3000;
+
+void Inline::execute() {
+  callSites.clear();
+  for (auto foo : m->function_list_) {
+    if (foo->basic_blocks_.empty())
+      continue;
+    // 不可达块会破坏支配树与循环的计算，先行删除
+    auto bbCount = foo->basic_blocks_.size();
+    DeleteUnusedBB(foo);
+    if (foo->basic_blocks_.size() != bbCount)
+      invalidateAnalysis(foo);
+    for (auto bb : foo->basic_blocks_)
+      for (auto instr : bb->instr_list_)
+        if (instr->is_call())
+          callSites[static_cast<Function *>(
+              instr->get_operand(instr->num_ops_ - 1))]++;
+  }
+
+  // 自底向上处理：被调函数中的调用已经内联，代价按内联后的规模计算
+  CallGraph cg(m);
+  callGraph = &cg;
+  int inlineCnt = 0;
+  for (auto caller : cg.getBottomUpOrder()) {
+    requireAnalysis(caller, LOOP_INFO);
+    // 拆分基本块会改变调用所在的块，先记下每个调用点的循环深度
+    std::vector<std::pair<CallInst *, int>> calls;
+    for (auto bb : caller->basic_blocks_)
+      for (auto instr : bb->instr_list_)
+        if (instr->is_call())
+          calls.push_back({static_cast<CallInst *>(instr), bb->loop_depth_});
+    for (auto [call, depth] : calls) {
+      if (!shouldInline(caller, call, depth))
+        continue;
+      inlineCall(caller, call);
+      invalidateAnalysis(caller);
+      inlineCnt++;
+    }
+  }
+  addStat("inline.inlined-calls", inlineCnt);
+
+  // 删除已无调用的函数，并解除其指令对操作数的引用，否则被调函数与全局变量
+  // 的 use_list 中会残留已删除函数中的使用。解除引用后其被调函数可能也不再
+  // 被调用，重复直到没有可删除的函数
+  bool removed = true;
+  while (removed) {
+    removed = false;
+    std::vector<Function *> functions;
+    for (auto foo : m->function_list_) {
+      if (foo->basic_blocks_.empty() || foo->name_ == "main" ||
+          !foo->use_list_.empty()) {
+        functions.push_back(foo);
+        continue;
+      }
+      for (auto bb : foo->basic_blocks_)
+        for (auto instr : bb->instr_list_)
+          instr->remove_use_of_ops();
+      removed = true;
+    }
+    m->function_list_ = functions;
+  }
+}
+
+int Inline::countInstr(Function *foo) {
+  int cnt = 0;
+  for (auto bb : foo->basic_blocks_)
+    cnt += bb->instr_list_.size();
+  return cnt;
+}
+
+bool Inline::shouldInline(Function *caller, CallInst *call, int depth) {
+  auto callee = static_cast<Function *>(call->get_operand(call->num_ops_ - 1));
+  if (callee->basic_blocks_.empty() || callee == caller ||
+      callee->getRetBB() == nullptr)
+    return false;
+  // 不内联直接或间接递归的函数
+  if (callGraph->isRecursive(callee))
+    return false;
+  int size = countInstr(callee);
+  if (countInstr(caller) + size > CALLER_SIZE_LIMIT)
+    return false;
+  if (callSites[callee] == 1 && size <= SINGLE_SITE_THRESHOLD)
+    return true;
+  return size <= INLINE_THRESHOLD << std::min(depth, MAX_INLINE_DEPTH);
+}
+
+Value *Inline::mapValue(Value *val) {
+  auto iter = valueMap.find(val);
+  return iter == valueMap.end() ? val : iter->second;
+}
+
+// 将 pos 之后的指令与 bb 的全部后继移入新的基本块
+BasicBlock *Inline::splitBlock(BasicBlock *bb, Instruction *pos) {
+  auto after = new BasicBlock(m, "", bb->parent_);
+  auto iter = pos->pos_in_bb.back();
+  std::vector<Instruction *> moved(++iter, bb->instr_list_.end());
+  for (auto instr : moved) {
+    bb->remove_instr(instr);
+    after->add_instruction(instr);
+  }
+  for (auto succ : bb->succ_bbs_) {
+    succ->remove_pre_basic_block(bb);
+    succ->add_pre_basic_block(after);
+    after->add_succ_basic_block(succ);
+    for (auto instr : succ->instr_list_) {
+      if (!instr->is_phi())
+        break;
+      for (int i = 1; i < instr->num_ops_; i += 2)
+        if (instr->get_operand(i) == bb) {
+          bb->remove_use(instr->use_pos_[i]);
+          instr->set_operand(i, after);
+        }
+    }
+  }
+  bb->succ_bbs_.clear();
+  return after;
+}
+
+void Inline::inlineCall(Function *caller, CallInst *call) {
+  auto callee = static_cast<Function *>(call->get_operand(call->num_ops_ - 1));
+  auto bb = call->parent_;
+  auto after = splitBlock(bb, call);
+  valueMap.clear();
+  for (int i = 0; i < callee->arguments_.size(); i++)
+    valueMap[callee->arguments_[i]] = call->get_operand(i);
+
+  // 按逆后序复制，保证除 phi 外的操作数先于使用者被复制
+  std::vector<BasicBlock *> order;
+  std::set<BasicBlock *> vis;
+  std::function<void(BasicBlock *)> dfs = [&](BasicBlock *cur) {
+    vis.insert(cur);
+    for (auto succ : cur->succ_bbs_)
+      if (!vis.count(succ))
+        dfs(succ);
+    order.push_back(cur);
+  };
+  dfs(callee->basic_blocks_.front());
+  std::reverse(order.begin(), order.end());
+
+  std::vector<BasicBlock *> newBlocks;
+  for (auto cbb : order) {
+    auto nbb = new BasicBlock(m, "", caller);
+    valueMap[cbb] = nbb;
+    newBlocks.push_back(nbb);
+  }
+  std::vector<std::pair<Instruction *, Instruction *>> phis;
+  std::vector<std::pair<Value *, BasicBlock *>> rets;
+  for (auto cbb : order) {
+    auto nbb = static_cast<BasicBlock *>(valueMap[cbb]);
+    for (auto instr : cbb->instr_list_) {
+      if (instr->is_ret()) {
+        if (instr->num_ops_)
+          rets.push_back({mapValue(instr->get_operand(0)), nbb});
+        new BranchInst(after, nbb);
+        continue;
+      }
+      auto newInstr = CloneInstr(instr, nbb, valueMap);
+      valueMap[instr] = newInstr;
+      // 被调函数中的调用复制到了调用处，成为新的调用点
+      if (newInstr->is_call())
+        callSites[static_cast<Function *>(
+            newInstr->get_operand(newInstr->num_ops_ - 1))]++;
+      if (instr->is_phi())
+        phis.push_back({instr, newInstr});
+    }
+  }
+  for (auto [phi, newPhi] : phis)
+    for (int i = 0; i < phi->num_ops_; i += 2)
+      if (valueMap.count(phi->get_operand(i + 1)))
+        static_cast<PhiInst *>(newPhi)->add_phi_pair_operand(
+            mapValue(phi->get_operand(i)), mapValue(phi->get_operand(i + 1)));
+
+  if (!call->use_list_.empty()) {
+    if (rets.size() == 1)
+      call->replace_all_use_with(rets.front().first);
+    else {
+      auto phi = PhiInst::create_phi(call->type_, after);
+      after->add_instruction_front(phi);
+      for (auto [val, retBB] : rets)
+        phi->add_phi_pair_operand(val, retBB);
+      call->replace_all_use_with(phi);
+    }
+  }
+  bb->delete_instr(call);
+  callSites[callee]--;
+  new BranchInst(newBlocks.front(), bb);
+
+  // 新块排在调用块之后，保持原有的布局顺序
+  auto &blocks = caller->basic_blocks_;
+  blocks.erase(blocks.end() - newBlocks.size() - 1, blocks.end());
+  newBlocks.push_back(after);
+  blocks.insert(std::find(blocks.begin(), blocks.end(), bb) + 1,
+                newBlocks.begin(), newBlocks.end());
+}
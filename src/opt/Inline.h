@@ -0,0 +1,26 @@
+#ifndef INLINEH
+#define INLINEH
+
+#include "CallGraph.h"
+
+// 函数内联：按调用图自底向上，将规模较小或只有一个调用点的非递归函数的
+// 函数体复制到调用处。
+// 调用所在的基本块在调用处拆分，形参替换为实参，
+// ret 改为跳转到拆分出的后继块，多个返回值通过 phi 合流。
+class Inline : public Optimization {
+  std::map<Value *, Value *> valueMap;
+  std::map<Function *, int> callSites;
+  CallGraph *callGraph;
+
+public:
+  Inline(Module *m) : Optimization(m) {}
+  void execute();
+  int countInstr(Function *foo);
+  // 代价模型：调用点所在的循环越深，允许内联的函数越大
+  bool shouldInline(Function *caller, CallInst *call, int depth);
+  void inlineCall(Function *caller, CallInst *call);
+  BasicBlock *splitBlock(BasicBlock *bb, Instruction *pos);
+  Value *mapValue(Value *val);
+};
+
+#endif // !INLINEH
@@ -0,0 +1,181 @@
+#include "LoopInfo.h"
+#include <algorithm>
+
+BasicBlock *Loop::getPreheader() {
+  BasicBlock *preheader = nullptr;
+  for (auto pre : header->pre_bbs_) {
+    if (contains(pre))
+      continue;
+    if (preheader != nullptr && preheader != pre)
+      return nullptr;
+    preheader = pre;
+  }
+  if (preheader == nullptr || preheader->succ_bbs_.size() != 1)
+    return nullptr;
+  return preheader;
+}
+
+std::vector<BasicBlock *> Loop::getExitingBlocks() {
+  std::vector<BasicBlock *> exiting;
+  for (auto bb : blocks)
+    for (auto succ : bb->succ_bbs_)
+      if (!contains(succ)) {
+        exiting.push_back(bb);
+        break;
+      }
+  return exiting;
+}
+
+std::vector<BasicBlock *> Loop::getExitBlocks() {
+  std::vector<BasicBlock *> exits;
+  for (auto bb : blocks)
+    for (auto succ : bb->succ_bbs_)
+      if (!contains(succ) &&
+          std::find(exits.begin(), exits.end(), succ) == exits.end())
+        exits.push_back(succ);
+  return exits;
+}
+
+void LoopInfo::execute() {
+  for (auto foo : m->function_list_)
+    if (!foo->basic_blocks_.empty())
+      requireAnalysis(foo, LOOP_INFO);
+}
+
+void LoopInfo::runOnFunction(Function *foo) {
+  for (auto loop : foo->loops_)
+    delete loop;
+  foo->loops_.clear();
+  for (auto bb : foo->basic_blocks_) {
+    bb->loop_ = nullptr;
+    bb->loop_depth_ = 0;
+  }
+  // 不可达块的 idom_ 没有意义，不参与循环的计算
+  std::set<BasicBlock *> reachable;
+  dfsGraph(foo->basic_blocks_.front(), reachable);
+
+  std::map<BasicBlock *, Loop *> headerLoop;
+  std::vector<Loop *> loops;
+  for (auto bb : foo->basic_blocks_) {
+    if (!reachable.count(bb))
+      continue;
+    for (auto succ : bb->succ_bbs_) {
+      if (succ != bb && succ->isDominate(bb) != 1)
+        continue;
+      auto &loop = headerLoop[succ];
+      if (loop == nullptr) {
+        loop = new Loop(succ);
+        loops.push_back(loop);
+      }
+      if (std::find(loop->latches.begin(), loop->latches.end(), bb) ==
+          loop->latches.end())
+        loop->latches.push_back(bb);
+    }
+  }
+
+  // 循环体：不经过循环头能到达回边起点的所有块
+  for (auto loop : loops) {
+    loop->blockSet.insert(loop->header);
+    std::vector<BasicBlock *> workList;
+    for (auto latch : loop->latches)
+      if (loop->blockSet.insert(latch).second)
+        workList.push_back(latch);
+    while (!workList.empty()) {
+      auto cur = workList.back();
+      workList.pop_back();
+      for (auto pre : cur->pre_bbs_)
+        if (reachable.count(pre) && loop->blockSet.insert(pre).second)
+          workList.push_back(pre);
+    }
+    for (auto bb : foo->basic_blocks_)
+      if (loop->contains(bb))
+        loop->blocks.push_back(bb);
+  }
+
+  // 自然循环或嵌套或不相交，按规模从大到小排列后，
+  // 包含循环头的最后一个循环即为直接外层循环
+  std::stable_sort(loops.begin(), loops.end(), [](Loop *a, Loop *b) {
+    return a->blockSet.size() > b->blockSet.size();
+  });
+  for (int i = 0; i < loops.size(); i++) {
+    auto loop = loops[i];
+    for (int j = i - 1; j >= 0; j--)
+      if (loops[j]->contains(loop->header)) {
+        loop->parent = loops[j];
+        loop->depth = loops[j]->depth + 1;
+        loops[j]->subLoops.push_back(loop);
+        break;
+      }
+    for (auto bb : loop->blocks) {
+      bb->loop_ = loop;
+      bb->loop_depth_ = loop->depth;
+    }
+  }
+  foo->loops_ = loops;
+}
+
+BasicBlock *LoopInfo::insertPreheader(Loop *loop) {
+  auto header = loop->header;
+  auto foo = header->parent_;
+  if (header == foo->basic_blocks_.front())
+    return nullptr;
+  auto preheader = new BasicBlock(m, "", foo);
+  auto &blocks = foo->basic_blocks_;
+  blocks.pop_back();
+  blocks.insert(std::find(blocks.begin(), blocks.end(), header), preheader);
+
+  // 循环外的 phi 入值在前置块中合流
+  for (auto instr : header->instr_list_) {
+    if (!instr->is_phi())
+      break;
+    std::vector<std::pair<Value *, Value *>> incoming;
+    for (int i = instr->num_ops_ - 2; i >= 0; i -= 2) {
+      auto pre = static_cast<BasicBlock *>(instr->get_operand(i + 1));
+      if (loop->contains(pre))
+        continue;
+      incoming.push_back({instr->get_operand(i), pre});
+      instr->remove_operands(i, i + 1);
+    }
+    Value *val = incoming.front().first;
+    if (std::any_of(incoming.begin(), incoming.end(),
+                    [&](auto &in) { return in.first != val; })) {
+      auto phi = PhiInst::create_phi(instr->type_, preheader);
+      preheader->add_instruction(phi);
+      for (auto [in, pre] : incoming)
+        phi->add_phi_pair_operand(in, pre);
+      val = phi;
+    }
+    static_cast<PhiInst *>(instr)->add_phi_pair_operand(val, preheader);
+  }
+
+  std::vector<BasicBlock *> outside;
+  for (auto pre : header->pre_bbs_)
+    if (!loop->contains(pre) &&
+        std::find(outside.begin(), outside.end(), pre) == outside.end())
+      outside.push_back(pre);
+  for (auto pre : outside) {
+    auto br = pre->get_terminator();
+    for (int i = 0; i < br->num_ops_; i++)
+      if (br->get_operand(i) == header) {
+        header->remove_use(br->use_pos_[i]);
+        br->set_operand(i, preheader);
+        preheader->add_pre_basic_block(pre);
+      }
+    std::replace(pre->succ_bbs_.begin(), pre->succ_bbs_.end(), header,
+                 preheader);
+    header->remove_pre_basic_block(pre);
+  }
+  new BranchInst(header, preheader);
+
+  preheader->idom_ = header->idom_;
+  header->idom_ = preheader;
+  for (auto outer = loop->parent; outer != nullptr; outer = outer->parent) {
+    outer->blockSet.insert(preheader);
+    outer->blocks.insert(
+        std::find(outer->blocks.begin(), outer->blocks.end(), header),
+        preheader);
+  }
+  preheader->loop_ = loop->parent;
+  preheader->loop_depth_ = loop->depth - 1;
+  return preheader;
+}
@@ -0,0 +1,41 @@
+#ifndef LOOPINFOH
+#define LOOPINFOH
+
+#include "BasicOperation.h"
+
+// 自然循环：由支配树回边 latch -> header（header 支配 latch）确定，
+// 同一循环头的回边合并为一个循环。
+class Loop {
+public:
+  BasicBlock *header;
+  Loop *parent = nullptr;          // 直接外层循环
+  std::vector<Loop *> subLoops;    // 直接内层循环
+  std::vector<BasicBlock *> blocks; // 按函数中的布局顺序
+  std::set<BasicBlock *> blockSet;
+  std::vector<BasicBlock *> latches; // 回边的起点
+  int depth = 1;
+
+  explicit Loop(BasicBlock *header_) : header(header_) {}
+  bool contains(BasicBlock *bb) { return blockSet.count(bb); }
+  // 唯一的循环外前驱，且其唯一后继为循环头；不存在时返回空
+  BasicBlock *getPreheader();
+  // 有后继在循环外的循环块
+  std::vector<BasicBlock *> getExitingBlocks();
+  // 循环外的后继块
+  std::vector<BasicBlock *> getExitBlocks();
+};
+
+// 循环分析：计算函数的循环嵌套树，结果保存在 Function::loops_、
+// BasicBlock::loop_ 与 BasicBlock::loop_depth_ 中。需要有效的支配树。
+class LoopInfo : public Optimization {
+public:
+  LoopInfo(Module *m) : Optimization(m) {}
+  void execute();
+  void runOnFunction(Function *foo);
+  // 为循环插入前置块：循环外前驱的跳转改为跳到前置块，循环头 phi
+  // 中循环外的入值移入前置块。同步更新 idom_ 与循环信息，但不更新支配边界。
+  // 循环头为函数入口时无法插入，返回空
+  BasicBlock *insertPreheader(Loop *loop);
+};
+
+#endif // !LOOPINFOH
@@ -1,149 +1,202 @@
 #include "LoopInvariant.h"
+#include "utils.h"
 
-void LoopInvariant::execute() {
-  searchLoop();
-  while (!loopStack.empty()) {
-    auto loop = loopStack.top();
-    loopStack.pop();
-    std::set<Value *> assignVals;
-    std::set<Instruction *> visInstr; // 标记下这条语句是不是被操作过
-    std::vector<Instruction *> invarInstrs; // 存在不变量的语句集合
-    std::map<Instruction *, BasicBlock *> instrPos;
-    for (auto bb : *loop)
-      for (Instruction *inst : bb->instr_list_)
-        // 赋值语句做操作
-        if (inst->is_binary() || inst->is_cmp() || inst->is_fcmp() ||
-            inst->is_call() || inst->is_phi() || inst->is_zext() ||
-            inst->is_fptosi() || inst->is_sitofp() || inst->is_gep() ||
-            inst->is_load())
-          assignVals.insert(inst);
-    bool changed = true;
-    while (changed) {
-      changed = false;
-      for (auto bb : *loop) {
-        for (auto instr : bb->instr_list_) {
-          if (visInstr.find(instr) != visInstr.end())
-            continue;
-          if (!instr->is_gep() && !instr->is_alloca() && !instr->is_br() &&
-              !instr->is_ret() && !instr->is_phi() && !instr->is_store() &&
-              !instr->is_load() &&
-              !(instr->is_call() &&
-                instr->get_operand(instr->num_ops_ - 1)->print() != "rand")) {
-            bool move = true;
-            // 一个操作数不是不变量就不能动
-            for (unsigned int i = 0; i < instr->num_ops_; i++)
-              if (assignVals.find(instr->get_operand(i)) != assignVals.end())
-                move = false;
-            if (move) {
-              instrPos[instr] = bb;
-              invarInstrs.push_back(instr);
-              assignVals.erase(instr);
-              visInstr.insert(instr);
-              changed = true;
-            }
-          }
-        }
-      }
+void LoopInvariant::runOnFunction(Function *foo) {
+  requireAnalysis(foo, LOOP_INFO);
+  int hoisted = 0, sunk = 0;
+  bool cfgChanged = false;
+  // 内层循环在前：外提到内层前置块的指令还可以继续被外层循环外提
+  auto loops = foo->loops_;
+  for (auto iter = loops.rbegin(); iter != loops.rend(); iter++) {
+    auto loop = *iter;
+    auto preheader = loop->getPreheader();
+    if (preheader == nullptr) {
+      preheader = LoopInfo(m).insertPreheader(loop);
+      if (preheader == nullptr)
+        continue;
+      cfgChanged = true;
     }
-    auto enter = entryPos[loop];
-    for (auto prev : enter->pre_bbs_)
-      if (loop->find(prev) == loop->end())
-        for (auto inst : invarInstrs)
-          prev->add_instruction_before_terminator(inst);
+    collectMemInstrs(loop);
+    hoisted += hoist(loop, preheader);
+    collectMemInstrs(loop);
+    sunk += sinkStores(loop, preheader);
   }
+  if (cfgChanged)
+    invalidateAnalysis(foo);
+  addStat("loop-invariant.hoisted-instrs", hoisted);
+  addStat("loop-invariant.sunk-stores", sunk);
 }
 
-void LoopInvariant::searchLoop() {
-  for (auto foo : m->function_list_) {
-    if (foo->basic_blocks_.empty())
-      continue;
-    std::set<node *> nodes;
-    std::set<node *> entry;
-    std::set<std::set<node *> *> SCCs;
-    std::map<BasicBlock *, node *> nodeMap;
-    for (auto bb : foo->basic_blocks_) {
-      auto cur = new node(bb, -1, -1, 0);
-      nodeMap[bb] = cur;
-      nodes.insert(cur);
-    }
-    for (auto bb : foo->basic_blocks_) {
-      auto BlockNode = nodeMap[bb];
-      for (auto suc : bb->succ_bbs_)
-        BlockNode->suc.insert(nodeMap[suc]);
-      for (auto pre : bb->succ_bbs_)
-        BlockNode->pre.insert(nodeMap[pre]);
-    }
+void LoopInvariant::collectMemInstrs(Loop *loop) {
+  memInstrs.clear();
+  for (auto bb : loop->blocks)
+    for (auto instr : bb->instr_list_)
+      if (instr->is_load() || instr->is_store() || instr->is_call())
+        memInstrs.push_back(instr);
+}
 
-    while (LoopInvariant::searchSCC(nodes, SCCs)) {
-      for (auto SCC : SCCs) {
-        node *enter = nullptr;
-        for (auto curBlock : *SCC)
-          for (auto pre : curBlock->pre)
-            if (SCC->find(pre) == SCC->end())
-              enter = curBlock;
-            else if (entry.find(pre) != entry.end())
-              enter = pre;
+bool LoopInvariant::isDereferenceable(Value *ptr) {
+  if (dynamic_cast<GlobalVariable *>(ptr) || dynamic_cast<AllocaInst *>(ptr))
+    return true;
+  auto gep = dynamic_cast<GetElementPtrInst *>(ptr);
+  if (gep == nullptr || !(dynamic_cast<GlobalVariable *>(gep->get_operand(0)) ||
+                          dynamic_cast<AllocaInst *>(gep->get_operand(0))))
+    return false;
+  auto first = dynamic_cast<ConstantInt *>(gep->get_operand(1));
+  if (first == nullptr || first->value_ != 0)
+    return false;
+  auto ty = static_cast<PointerType *>(gep->get_operand(0)->type_)->contained_;
+  for (int i = 2; i < gep->num_ops_; i++) {
+    auto idx = dynamic_cast<ConstantInt *>(gep->get_operand(i));
+    if (ty->tid_ != Type::ArrayTyID || idx == nullptr || idx->value_ < 0 ||
+        idx->value_ >= static_cast<ArrayType *>(ty)->num_elements_)
+      return false;
+    ty = static_cast<ArrayType *>(ty)->contained_;
+  }
+  return true;
+}
 
-        auto curLoop = new std::set<BasicBlock *>;
-        for (auto curBlock : *SCC)
-          curLoop->insert(curBlock->bb);
-        entryPos[curLoop] = enter->bb;
-        loopStack.push(curLoop);
-        entry.insert(enter);
-        nodes.erase(enter);
-        for (auto pre : enter->pre)
-          pre->suc.erase(enter);
-        for (auto suc : enter->suc)
-          suc->pre.erase(enter);
-      }
-      for (auto SCC : SCCs)
-        SCC->clear();
-      SCCs.clear();
-      for (auto NodeBlock : nodes)
-        NodeBlock = new node(nullptr, -1, -1, false);
-    }
-    for (auto node : nodes)
-      delete node;
+bool LoopInvariant::canHoist(Loop *loop, Instruction *instr) {
+  if (instr->is_alloca() || instr->is_br() || instr->is_ret() ||
+      instr->is_phi() || instr->is_store())
+    return false;
+  // 纯函数仍可能除以 0 或不终止，只外提每次进入循环都会执行的循环头中的调用
+  if (instr->is_call())
+    return info->getCallEffect(instr).pure() && instr->parent_ == loop->header;
+  // 除法只在除数为非零常量时外提，避免执行原本被条件跳过的除以 0
+  if (instr->op_id_ == Instruction::SDiv ||
+      instr->op_id_ == Instruction::SRem ||
+      instr->op_id_ == Instruction::UDiv ||
+      instr->op_id_ == Instruction::URem) {
+    auto divisor = dynamic_cast<ConstantInt *>(instr->get_operand(1));
+    return divisor != nullptr && divisor->value_ != 0 && divisor->value_ != -1;
+  }
+  if (instr->is_load()) {
+    auto ptr = instr->get_operand(0);
+    for (auto memInstr : memInstrs)
+      if (aa->mayAccess(memInstr, ptr, true, loop->header))
+        return false;
+    // 循环可能一次也不执行，只有循环头中的读取或不会越界的读取可以提前
+    return instr->parent_ == loop->header || isDereferenceable(ptr);
   }
+  return true;
 }
 
-bool LoopInvariant::searchSCC(std::set<node *> &basicBlocks,
-                              std::set<std::set<node *> *> &SCCs) {
-  ind = 0;
-  while (!tarjanStack.empty())
-    tarjanStack.pop();
-  for (auto cur : basicBlocks)
-    if (cur->dfn == -1)
-      tarjan(cur, SCCs);
-  return SCCs.size() != 0;
+int LoopInvariant::hoist(Loop *loop, BasicBlock *preheader) {
+  std::set<Value *> assignVals; // 在循环内定义的值
+  std::vector<Instruction *> invarInstrs; // 按依赖顺序排列的不变量
+  for (auto bb : loop->blocks)
+    for (auto instr : bb->instr_list_)
+      assignVals.insert(instr);
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto bb : loop->blocks)
+      for (auto instr : bb->instr_list_) {
+        if (!assignVals.count(instr) || !canHoist(loop, instr))
+          continue;
+        bool move = true;
+        // 一个操作数不是不变量就不能动
+        for (unsigned int i = 0; i < instr->num_ops_; i++)
+          if (assignVals.count(instr->get_operand(i)))
+            move = false;
+        if (move) {
+          invarInstrs.push_back(instr);
+          assignVals.erase(instr);
+          changed = true;
+        }
+      }
+  }
+  for (auto instr : invarInstrs) {
+    instr->parent_->remove_instr(instr);
+    preheader->add_instruction_before_terminator(instr);
+  }
+  return invarInstrs.size();
 }
 
-void LoopInvariant::tarjan(node *cur, std::set<std::set<node *> *> &SCCs) {
-  cur->dfn = cur->low = ++ind;
-  cur->inStack = true;
-  tarjanStack.push(cur);
-  for (auto succ : cur->suc)
-    if (succ->dfn == -1) {
-      tarjan(succ, SCCs);
-      if (succ->low < cur->low)
-        cur->low = succ->low;
-    } else if (succ->inStack && succ->low < cur->low)
-      cur->low = succ->low;
-  // 找到low=dfn的，出现强连通分量
-  if (cur->dfn == cur->low) {
-    if (cur == tarjanStack.top()) {
-      tarjanStack.pop();
-      cur->inStack = false;
-      return;
+// 只处理循环头为唯一出口、出口块只有循环头一个前驱的最内层循环。
+// store 所在块支配所有回边起点，即每次迭代都恰好写入一次，
+// 于是进入循环头时内存中的值可以用 phi 表示：
+//   循环头：v = phi [load ptr, preheader], [val, latch]
+// 循环内对 ptr 的读取替换为 v 或 val，退出后将 v 写回。
+int LoopInvariant::sinkStores(Loop *loop, BasicBlock *preheader) {
+  if (!loop->subLoops.empty())
+    return 0;
+  auto exiting = loop->getExitingBlocks();
+  auto exits = loop->getExitBlocks();
+  if (exiting.size() != 1 || exiting.front() != loop->header ||
+      exits.size() != 1 || exits.front()->pre_bbs_.size() != 1)
+    return 0;
+  auto exit = exits.front();
+  auto header = loop->header;
+  // 同一块中 a 在 b 之前
+  auto before = [](Instruction *a, Instruction *b) {
+    for (auto instr : a->parent_->instr_list_)
+      if (instr == a || instr == b)
+        return instr == a;
+    return false;
+  };
+
+  int sunk = 0;
+  std::vector<Instruction *> stores;
+  for (auto instr : memInstrs)
+    if (instr->is_store())
+      stores.push_back(instr);
+  for (auto store : stores) {
+    auto ptr = store->get_operand(1);
+    auto sbb = store->parent_;
+    auto ptrInstr = dynamic_cast<Instruction *>(ptr);
+    if ((ptrInstr && loop->contains(ptrInstr->parent_)) ||
+        !isDereferenceable(ptr))
+      continue;
+    bool legal = true;
+    for (auto latch : loop->latches)
+      if (latch != sbb && sbb->isDominate(latch) != 1)
+        legal = false;
+    // 读取 ptr 的位置：true 表示在 store 之后，读到的是本次迭代写入的值
+    std::vector<std::pair<Instruction *, bool>> loads;
+    for (auto instr : memInstrs) {
+      if (!legal || instr == store)
+        continue;
+      if (!instr->is_load() || instr->get_operand(0) != ptr) {
+        legal = !aa->mayAccess(instr, ptr, false, loop->header);
+        continue;
+      }
+      auto lbb = instr->parent_;
+      if (lbb == sbb)
+        loads.push_back({instr, before(store, instr)});
+      else if (sbb->isDominate(lbb) == 1)
+        loads.push_back({instr, true});
+      else if (lbb->isDominate(sbb) == 1)
+        loads.push_back({instr, false});
+      else
+        legal = false;
     }
-    auto SCC = new std::set<node *>;
-    node *tp = nullptr;
-    do {
-      tp = tarjanStack.top();
-      SCC->insert(tp);
-      tarjanStack.pop();
-      tp->inStack = false;
-    } while (tp != cur);
-    SCCs.insert(SCC);
+    if (!legal)
+      continue;
+
+    auto val = store->get_operand(0);
+    auto init = new LoadInst(ptr, preheader);
+    preheader->remove_instr(init);
+    preheader->add_instruction_before_terminator(init);
+    auto phi = PhiInst::create_phi(val->type_, header);
+    header->add_instruction_front(phi);
+    phi->add_phi_pair_operand(init, preheader);
+    for (auto latch : loop->latches)
+      phi->add_phi_pair_operand(val, latch);
+    for (auto [load, afterStore] : loads) {
+      load->replace_all_use_with(afterStore ? val : static_cast<Value *>(phi));
+      load->parent_->delete_instr(load);
+    }
+    sbb->delete_instr(store);
+    auto firstInstr = exit->instr_list_.begin();
+    while ((*firstInstr)->is_phi())
+      firstInstr++;
+    auto writeBack = new StoreInst(phi, ptr, exit);
+    exit->remove_instr(writeBack);
+    exit->add_instruction_before_inst(writeBack, *firstInstr);
+    sunk++;
+    collectMemInstrs(loop);
   }
-}
\ No newline at end of file
+  return sunk;
+}
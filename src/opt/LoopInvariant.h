@@ -2,30 +2,35 @@
 #define LOOPH
 
 #include "BasicOperation.h"
+#include "LoopInfo.h"
+#include "AliasAnalysis.h"
 
-struct node {
-  BasicBlock *bb;
-  std::set<node *> pre;
-  std::set<node *> suc;
-  int dfn, low;
-  bool inStack;
-  node() = default;
-  node(BasicBlock *bb_, int dfn_, int low_, bool inStack_)
-      : bb(bb_), dfn(dfn_), low(low_), inStack(inStack_) {}
-};
-
-class LoopInvariant : public Optimization {
-  int ind;
-  std::stack<node *> tarjanStack;
-  std::stack<std::set<BasicBlock *> *> loopStack;
-  std::map<std::set<BasicBlock *> *, BasicBlock *> entryPos;
+// 循环不变量外提：由内向外处理每个循环，操作数均在循环外定义的计算
+// 移入循环的前置块（没有时新建）。
+// 地址计算总可以外提；读取的内存在循环中没有可能别名的写入时，load 也可外提；
+// 循环头中纯函数的调用也可外提。
+// 最内层循环中对不变地址的唯一一次写入改为在循环中以 phi 传递，
+// 循环退出后再写回内存。
+class LoopInvariant : public FunctionPass {
+  std::vector<Instruction *> memInstrs; // 当前循环中的 load、store 与调用
 
 public:
-  LoopInvariant(Module *m) : Optimization(m) {}
-  void execute();
-  void searchLoop();
-  bool searchSCC(std::set<node *> &basicBlock, std::set<std::set<node *> *> &SCCs);
-  void tarjan(node *pos, std::set<std::set<node *> *> &SCCs);
+  LoopInvariant(Module *m) : FunctionPass(m) {}
+  void runOnFunction(Function *foo);
+  int required() { return LOOP_INFO; }
+  int requiredModule() { return ALIAS_ANALYSIS; }
+  int preserved() { return ALL_ANALYSIS; }
+  // 收集循环中的访存指令到 memInstrs
+  void collectMemInstrs(Loop *loop);
+  // 返回外提的指令数
+  int hoist(Loop *loop, BasicBlock *preheader);
+  // 指令可以提前到循环之前执行：无副作用且不会因提前执行而出错
+  bool canHoist(Loop *loop, Instruction *instr);
+  // 返回下沉到循环之后的 store 数
+  int sinkStores(Loop *loop, BasicBlock *preheader);
+
+  // 在循环之前读取 ptr 也不会越界
+  bool isDereferenceable(Value *ptr);
 };
 
-#endif // !LOOPH
\ No newline at end of file
+#endif // !LOOPH
@@ -0,0 +1,399 @@
+#include "LoopUnroll.h"
+#include "utils.h"
+#include <algorithm>
+#include <climits>
+#include <functional>
+
+int LoopUnroll::factor = 4;
+int LoopUnroll::fullThreshold = 256;
+
+// 条件取反与交换两个操作数后的比较
+static const std::map<ICmpInst::ICmpOp, ICmpInst::ICmpOp> inverseOp = {
+    {ICmpInst::ICMP_EQ, ICmpInst::ICMP_NE},
+    {ICmpInst::ICMP_NE, ICmpInst::ICMP_EQ},
+    {ICmpInst::ICMP_SGT, ICmpInst::ICMP_SLE},
+    {ICmpInst::ICMP_SGE, ICmpInst::ICMP_SLT},
+    {ICmpInst::ICMP_SLT, ICmpInst::ICMP_SGE},
+    {ICmpInst::ICMP_SLE, ICmpInst::ICMP_SGT}};
+static const std::map<ICmpInst::ICmpOp, ICmpInst::ICmpOp> swappedOp = {
+    {ICmpInst::ICMP_EQ, ICmpInst::ICMP_EQ},
+    {ICmpInst::ICMP_NE, ICmpInst::ICMP_NE},
+    {ICmpInst::ICMP_SGT, ICmpInst::ICMP_SLT},
+    {ICmpInst::ICMP_SGE, ICmpInst::ICMP_SLE},
+    {ICmpInst::ICMP_SLT, ICmpInst::ICMP_SGT},
+    {ICmpInst::ICMP_SLE, ICmpInst::ICMP_SGE}};
+
+static bool evalICmp(ICmpInst::ICmpOp op, long long lhs, long long rhs) {
+  switch (op) {
+  case ICmpInst::ICMP_EQ:
+    return lhs == rhs;
+  case ICmpInst::ICMP_NE:
+    return lhs != rhs;
+  case ICmpInst::ICMP_SGT:
+    return lhs > rhs;
+  case ICmpInst::ICMP_SGE:
+    return lhs >= rhs;
+  case ICmpInst::ICMP_SLT:
+    return lhs < rhs;
+  default:
+    return lhs <= rhs;
+  }
+}
+
+static Value *getIncoming(Instruction *phi, BasicBlock *bb) {
+  for (int i = 1; i < phi->num_ops_; i += 2)
+    if (phi->get_operand(i) == bb)
+      return phi->get_operand(i - 1);
+  return nullptr;
+}
+
+void LoopUnroll::runOnFunction(Function *foo) {
+  fullCnt = partialCnt = 0;
+  // 展开得到的循环与执行剩余迭代的原循环不再展开
+  std::set<BasicBlock *> done;
+  bool cfgChanged = false;
+  for (bool unrolled = true; unrolled;) {
+    unrolled = false;
+    requireAnalysis(foo, LOOP_INFO);
+    for (auto loop : foo->loops_) {
+      if (done.count(loop->header) || !loop->subLoops.empty())
+        continue;
+      done.insert(loop->header);
+      preheader = loop->getPreheader();
+      if (preheader == nullptr) {
+        preheader = LoopInfo(m).insertPreheader(loop);
+        if (preheader == nullptr)
+          continue;
+        cfgChanged = true;
+      }
+      if (!analyze(loop))
+        continue;
+      int size = countInstr();
+      int tripCount = getTripCount(fullThreshold / size);
+      if (tripCount == 0)
+        continue;
+      if (tripCount > 0) {
+        fullyUnroll(tripCount);
+        fullCnt++;
+      } else if (canPartiallyUnroll(size)) {
+        partiallyUnroll();
+        done.insert(newBlocks.front());
+        partialCnt++;
+      } else
+        continue;
+      unrolled = true;
+      break;
+    }
+    if (unrolled)
+      invalidateAnalysis(foo);
+  }
+  if (cfgChanged)
+    invalidateAnalysis(foo);
+  addStat("unroll.fully-unrolled", fullCnt);
+  addStat("unroll.partially-unrolled", partialCnt);
+}
+
+bool LoopUnroll::analyze(Loop *loop_) {
+  loop = loop_;
+  header = loop->header;
+  if (loop->latches.size() != 1 || loop->latches.front() == header ||
+      loop->getExitingBlocks() != std::vector<BasicBlock *>{header})
+    return false;
+  latch = loop->latches.front();
+  auto br = header->get_terminator();
+  if (br->num_ops_ != 3)
+    return false;
+  cmp = dynamic_cast<ICmpInst *>(br->get_operand(0));
+  if (cmp == nullptr || cmp->parent_ != header || cmp->use_list_.size() != 1)
+    return false;
+  auto op = static_cast<ICmpInst *>(cmp)->icmp_op_;
+  if (!inverseOp.count(op))
+    return false;
+  inBB = static_cast<BasicBlock *>(br->get_operand(1));
+  exitBB = static_cast<BasicBlock *>(br->get_operand(2));
+  if (!loop->contains(inBB)) {
+    std::swap(inBB, exitBB);
+    op = inverseOp.at(op);
+  }
+
+  headerPhis.clear();
+  for (auto instr : header->instr_list_) {
+    if (!instr->is_phi())
+      break;
+    if (instr->num_ops_ != 4 || getIncoming(instr, preheader) == nullptr ||
+        getIncoming(instr, latch) == nullptr)
+      return false;
+    headerPhis.push_back(instr);
+  }
+  auto isHeaderPhi = [&](Value *val) {
+    return std::find(headerPhis.begin(), headerPhis.end(), val) !=
+           headerPhis.end();
+  };
+  Value *lhs = cmp->get_operand(0), *rhs = cmp->get_operand(1);
+  if (!isHeaderPhi(lhs)) {
+    std::swap(lhs, rhs);
+    op = swappedOp.at(op);
+  }
+  auto rinstr = dynamic_cast<Instruction *>(rhs);
+  if (!isHeaderPhi(lhs) || (rinstr && loop->contains(rinstr->parent_)))
+    return false;
+  iv = static_cast<Instruction *>(lhs);
+  bound = rhs;
+  stayOp = op;
+
+  // iv 每次迭代增加常量步长
+  ivNext = dynamic_cast<Instruction *>(getIncoming(iv, latch));
+  if (ivNext == nullptr || !loop->contains(ivNext->parent_) ||
+      (!ivNext->is_add() && !ivNext->is_sub()))
+    return false;
+  Value *stepVal = nullptr;
+  if (ivNext->get_operand(0) == iv)
+    stepVal = ivNext->get_operand(1);
+  else if (ivNext->is_add() && ivNext->get_operand(1) == iv)
+    stepVal = ivNext->get_operand(0);
+  auto cstep = dynamic_cast<ConstantInt *>(stepVal);
+  if (cstep == nullptr || cstep->value_ == 0)
+    return false;
+  step = ivNext->is_add() ? cstep->value_ : -cstep->value_;
+
+  body.clear();
+  std::set<BasicBlock *> vis = {header};
+  std::function<void(BasicBlock *)> dfs = [&](BasicBlock *bb) {
+    vis.insert(bb);
+    for (auto succ : bb->succ_bbs_)
+      if (loop->contains(succ) && !vis.count(succ))
+        dfs(succ);
+    body.push_back(bb);
+  };
+  dfs(inBB);
+  std::reverse(body.begin(), body.end());
+  // 局部数组的栈空间不复制
+  for (auto bb : body)
+    for (auto instr : bb->instr_list_)
+      if (instr->is_alloca())
+        return false;
+  return true;
+}
+
+int LoopUnroll::countInstr() {
+  int cnt = 0;
+  for (auto bb : loop->blocks)
+    cnt += bb->instr_list_.size();
+  return cnt;
+}
+
+int LoopUnroll::getTripCount(int limit) {
+  auto init = dynamic_cast<ConstantInt *>(getIncoming(iv, preheader));
+  auto n = dynamic_cast<ConstantInt *>(bound);
+  if (init == nullptr || n == nullptr)
+    return -1;
+  long long val = init->value_;
+  for (int cnt = 0; cnt <= limit; cnt++) {
+    if (!evalICmp(stayOp, val, n->value_))
+      return cnt;
+    val += step;
+    if (val < INT_MIN || val > INT_MAX)
+      return -1;
+  }
+  return -1;
+}
+
+// 部分展开只处理 iv 单调趋近 bound 的循环，
+// 此时 iv + (factor - 1) * step 满足循环条件即剩余迭代不少于 factor 次
+bool LoopUnroll::canPartiallyUnroll(int size) {
+  if (factor <= 1 || size * factor > fullThreshold)
+    return false;
+  if (!(step > 0 && (stayOp == ICmpInst::ICMP_SLT ||
+                     stayOp == ICmpInst::ICMP_SLE)) &&
+      !(step < 0 && (stayOp == ICmpInst::ICMP_SGT ||
+                     stayOp == ICmpInst::ICMP_SGE)))
+    return false;
+  long long delta = (long long)(factor - 1) * step;
+  if (auto n = dynamic_cast<ConstantInt *>(bound))
+    return n->value_ - delta >= INT_MIN && n->value_ - delta <= INT_MAX;
+  return delta >= INT_MIN && delta <= INT_MAX;
+}
+
+Value *LoopUnroll::mapValue(Value *val) {
+  auto iter = valueMap.find(val);
+  return iter == valueMap.end() ? val : iter->second;
+}
+
+void LoopUnroll::retarget(BasicBlock *target, Value *cond) {
+  preheader->delete_instr(preheader->get_terminator());
+  preheader->remove_succ_basic_block(header);
+  header->remove_pre_basic_block(preheader);
+  if (cond)
+    new BranchInst(cond, target, header, preheader);
+  else
+    new BranchInst(target, preheader);
+}
+
+BasicBlock *LoopUnroll::cloneIteration(int k, BasicBlock *copy,
+                                       BasicBlock *next) {
+  auto foo = header->parent_;
+  auto i32 = m->int32_ty_;
+  // 各份副本中 iv 的递增都直接由 ivBase 加上常量得到，不形成依赖链
+  auto clone = [&](Instruction *instr, BasicBlock *bb) -> Instruction * {
+    if (instr == ivNext)
+      return new BinaryInst(i32, Instruction::Add, ivBase,
+                            m->get_const_int(i32, (k + 1) * step), bb);
+    return CloneInstr(instr, bb, valueMap);
+  };
+  newBlocks.push_back(copy);
+  valueMap[header] = copy;
+  // 副本中不再判断是否退出
+  for (auto instr : header->instr_list_)
+    if (!instr->is_phi() && !instr->isTerminator() && instr != cmp)
+      valueMap[instr] = clone(instr, copy);
+  for (auto bb : body) {
+    auto nbb = new BasicBlock(m, "", foo);
+    valueMap[bb] = nbb;
+    newBlocks.push_back(nbb);
+  }
+  new BranchInst(static_cast<BasicBlock *>(valueMap[inBB]), copy);
+
+  std::vector<std::pair<Instruction *, Instruction *>> phis;
+  for (auto bb : body) {
+    auto nbb = static_cast<BasicBlock *>(valueMap[bb]);
+    for (auto instr : bb->instr_list_) {
+      // 回边改为跳到下一次迭代
+      if (bb == latch && instr->isTerminator())
+        valueMap[header] = next;
+      auto newInstr = clone(instr, nbb);
+      valueMap[instr] = newInstr;
+      if (instr->is_phi())
+        phis.push_back({instr, newInstr});
+    }
+  }
+  valueMap[header] = copy;
+  for (auto [phi, newPhi] : phis)
+    for (int i = 0; i < phi->num_ops_; i += 2)
+      static_cast<PhiInst *>(newPhi)->add_phi_pair_operand(
+          mapValue(phi->get_operand(i)), mapValue(phi->get_operand(i + 1)));
+
+  // 循环头 phi 同时取回边上的值
+  std::vector<Value *> nextVals;
+  for (auto phi : headerPhis)
+    nextVals.push_back(mapValue(getIncoming(phi, latch)));
+  for (int i = 0; i < headerPhis.size(); i++)
+    valueMap[headerPhis[i]] = nextVals[i];
+  return static_cast<BasicBlock *>(valueMap[latch]);
+}
+
+void LoopUnroll::placeNewBlocks() {
+  auto &blocks = header->parent_->basic_blocks_;
+  std::set<BasicBlock *> added(newBlocks.begin(), newBlocks.end());
+  blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                              [&](BasicBlock *bb) { return added.count(bb); }),
+               blocks.end());
+  blocks.insert(std::find(blocks.begin(), blocks.end(), header),
+                newBlocks.begin(), newBlocks.end());
+  for (auto bb : newBlocks)
+    MergeIntoPreBB(bb);
+}
+
+// preheader -> H0 -> ... -> H(n-1) -> H -> exit，
+// 原循环头中的 phi 替换为最后一次迭代后的值，原循环体变为不可达
+void LoopUnroll::fullyUnroll(int tripCount) {
+  auto foo = header->parent_;
+  valueMap.clear();
+  newBlocks.clear();
+  for (auto phi : headerPhis)
+    valueMap[phi] = getIncoming(phi, preheader);
+  ivBase = valueMap[iv];
+  auto copy = new BasicBlock(m, "", foo);
+  retarget(copy);
+  for (int k = 0; k < tripCount; k++) {
+    auto next = k + 1 < tripCount ? new BasicBlock(m, "", foo) : header;
+    cloneIteration(k, copy, next);
+    copy = next;
+  }
+
+  for (auto phi : headerPhis) {
+    phi->replace_all_use_with(mapValue(phi));
+    header->delete_instr(phi);
+  }
+  header->delete_instr(header->get_terminator());
+  header->delete_instr(cmp);
+  header->remove_succ_basic_block(inBB);
+  inBB->remove_pre_basic_block(header);
+  header->remove_succ_basic_block(exitBB);
+  exitBB->remove_pre_basic_block(header);
+  new BranchInst(exitBB, header);
+  placeNewBlocks();
+  DeleteUnusedBB(foo);
+  MergeIntoPreBB(header);
+}
+
+// preheader -> G，G 中的 phi 合流循环头 phi 的初值与展开的循环体的结果：
+// G: 剩余迭代不少于 factor 次时执行 H0 -> ... -> H(factor-1) -> G，否则 -> H。
+// 原循环头 phi 的初值改为 G 中对应的 phi。
+// bound 为变量时 bound - delta 可能溢出，此时剩余迭代一定少于 factor 次，
+// preheader 先判断是否溢出，溢出时直接跳到 H
+void LoopUnroll::partiallyUnroll() {
+  auto foo = header->parent_;
+  auto i32 = m->int32_ty_;
+  valueMap.clear();
+  newBlocks.clear();
+  long long delta = (long long)(factor - 1) * step;
+  Value *limit, *safe = nullptr;
+  if (auto n = dynamic_cast<ConstantInt *>(bound))
+    limit = m->get_const_int(i32, n->value_ - delta);
+  else {
+    auto sub = new BinaryInst(i32, Instruction::Sub, bound,
+                              m->get_const_int(i32, delta), preheader);
+    preheader->remove_instr(sub);
+    preheader->add_instruction_before_terminator(sub);
+    limit = sub;
+    auto cmp = step > 0 ? new ICmpInst(ICmpInst::ICMP_SGE, bound,
+                                       m->get_const_int(i32, INT_MIN + delta),
+                                       preheader)
+                        : new ICmpInst(ICmpInst::ICMP_SLE, bound,
+                                       m->get_const_int(i32, INT_MAX + delta),
+                                       preheader);
+    preheader->remove_instr(cmp);
+    preheader->add_instruction_before_terminator(cmp);
+    safe = cmp;
+  }
+
+  auto guard = new BasicBlock(m, "", foo);
+  newBlocks.push_back(guard);
+  std::vector<PhiInst *> guardPhis;
+  for (auto phi : headerPhis) {
+    auto guardPhi = PhiInst::create_phi(phi->type_, guard);
+    guard->add_instruction(guardPhi);
+    guardPhi->add_phi_pair_operand(getIncoming(phi, preheader), preheader);
+    guardPhis.push_back(guardPhi);
+    valueMap[phi] = guardPhi;
+  }
+  ivBase = valueMap[iv];
+  auto cond = new ICmpInst(stayOp, ivBase, limit, guard);
+  auto copy = new BasicBlock(m, "", foo);
+  new BranchInst(cond, copy, header, guard);
+  retarget(guard, safe);
+  BasicBlock *latchCopy = nullptr;
+  for (int k = 0; k < factor; k++) {
+    auto next = k + 1 < factor ? new BasicBlock(m, "", foo) : guard;
+    latchCopy = cloneIteration(k, copy, next);
+    copy = next;
+  }
+
+  for (int i = 0; i < headerPhis.size(); i++) {
+    auto phi = headerPhis[i];
+    guardPhis[i]->add_phi_pair_operand(mapValue(phi), latchCopy);
+    // preheader 仍可能直接跳到 H，保留原来的初值
+    if (safe) {
+      static_cast<PhiInst *>(phi)->add_phi_pair_operand(guardPhis[i], guard);
+      continue;
+    }
+    for (int j = 1; j < phi->num_ops_; j += 2)
+      if (phi->get_operand(j) == preheader) {
+        phi->get_operand(j - 1)->remove_use(phi->use_pos_[j - 1]);
+        phi->set_operand(j - 1, guardPhis[i]);
+        preheader->remove_use(phi->use_pos_[j]);
+        phi->set_operand(j, guard);
+      }
+  }
+  placeNewBlocks();
+}
@@ -0,0 +1,55 @@
+#ifndef LOOPUNROLLH
+#define LOOPUNROLLH
+
+#include "BasicOperation.h"
+#include "LoopInfo.h"
+
+// 循环展开：处理只在循环头以 icmp iv, n 判断退出的最内层循环，
+// iv 为步长是常量的基本归纳变量，n 为循环不变量。
+// 1. 迭代次数为常量且展开后规模不超过 fullThreshold 时完全展开，
+//    原循环头只保留最后一次退出判断；
+// 2. 否则按 factor 部分展开：新的循环头判断剩余迭代不少于 factor 次时
+//    执行展开后的 factor 份循环体，其余迭代仍由原循环执行。
+class LoopUnroll : public FunctionPass {
+  Loop *loop;
+  BasicBlock *preheader, *header, *latch;
+  BasicBlock *inBB, *exitBB;      // 循环头在循环内与循环外的后继
+  std::vector<BasicBlock *> body; // 除循环头外的循环块，按逆后序排列
+  std::vector<Instruction *> headerPhis;
+  Instruction *iv, *ivNext, *cmp;
+  Value *ivBase; // 第 k 份副本中 iv 的值为 ivBase + k * step
+  int step;
+  ICmpInst::ICmpOp stayOp; // stayOp(iv, bound) 成立时继续循环
+  Value *bound;
+  std::map<Value *, Value *> valueMap; // 原循环中的值到当前副本的映射
+  std::vector<BasicBlock *> newBlocks; // 新建的块，按布局顺序
+  int fullCnt, partialCnt;
+
+public:
+  static int factor;        // 部分展开的份数，不大于 1 时不部分展开
+  static int fullThreshold; // 展开后循环体的指令数上限
+
+  LoopUnroll(Module *m) : FunctionPass(m) {}
+  void runOnFunction(Function *foo);
+  int required() { return LOOP_INFO; }
+  int preserved() { return ALL_ANALYSIS; }
+  // 识别循环的形状，不满足展开条件时返回 false
+  bool analyze(Loop *loop_);
+  int countInstr();
+  // 常量迭代次数，不是常量或超过 limit 时返回 -1
+  int getTripCount(int limit);
+  bool canPartiallyUnroll(int size);
+  Value *mapValue(Value *val);
+  // 将 preheader 跳到循环头的边改为跳到 target；
+  // 给出 cond 时只在 cond 成立时跳到 target，否则仍跳到循环头
+  void retarget(BasicBlock *target, Value *cond = nullptr);
+  // 复制第 k 份循环体：循环头的计算放在 copy 中，回边跳到 next。
+  // 之后 valueMap 中循环头 phi 映射为下一次迭代的值。返回回边起点的副本
+  BasicBlock *cloneIteration(int k, BasicBlock *copy, BasicBlock *next);
+  // 新块排在原循环头之前，并合并只有单一跳转相连的块
+  void placeNewBlocks();
+  void fullyUnroll(int tripCount);
+  void partiallyUnroll();
+};
+
+#endif // !LOOPUNROLLH
@@ -0,0 +1,197 @@
+#include "Mem2Reg.h"
+#include <functional>
+
+void Mem2Reg::runOnFunction(Function *foo) {
+  // 不可达块会破坏支配树的计算，先行删除
+  auto bbCount = foo->basic_blocks_.size();
+  DeleteUnusedBB(foo);
+  if (foo->basic_blocks_.size() != bbCount)
+    invalidateAnalysis(foo);
+  requireAnalysis(foo, DOMINATOR);
+  promotable.clear();
+  phiAlloca.clear();
+  valueStack.clear();
+  domChildren.clear();
+  uselessInstr.clear();
+  for (auto bb : foo->basic_blocks_)
+    for (auto instr : bb->instr_list_)
+      if (instr->is_alloca() &&
+          isPromotable(foo, static_cast<AllocaInst *>(instr)))
+        promotable.insert(static_cast<AllocaInst *>(instr));
+  if (promotable.empty())
+    return;
+  auto entry = foo->basic_blocks_.front();
+  for (auto bb : foo->basic_blocks_)
+    if (bb != entry)
+      domChildren[bb->idom_].push_back(bb);
+  insertPhi(foo);
+  rename(entry);
+  for (auto instr : uselessInstr)
+    instr->parent_->delete_instr(instr);
+  for (auto alloca : promotable)
+    alloca->parent_->delete_instr(alloca);
+  deleteUselessPhi(foo);
+}
+
+bool Mem2Reg::isPromotable(Function *foo, AllocaInst *alloca) {
+  auto ty = alloca->alloca_ty_;
+  if (ty->tid_ != Type::IntegerTyID && ty->tid_ != Type::FloatTyID &&
+      ty->tid_ != Type::PointerTyID)
+    return false;
+  int storeCnt = 0;
+  BasicBlock *storeBB = nullptr;
+  for (auto use : alloca->use_list_) {
+    auto instr = dynamic_cast<Instruction *>(use.val_);
+    if (instr == nullptr)
+      return false;
+    if (instr->is_load() && use.arg_no_ == 0)
+      continue;
+    if (instr->is_store() && use.arg_no_ == 1) {
+      storeCnt++;
+      storeBB = instr->parent_;
+      continue;
+    }
+    return false;
+  }
+  if (ty->tid_ != Type::PointerTyID)
+    return true;
+  // 指针没有合适的未定义值，只提升入口块中先存后取的形参指针
+  auto entry = foo->basic_blocks_.front();
+  if (storeCnt != 1 || storeBB != entry)
+    return false;
+  for (auto instr : entry->instr_list_) {
+    if (instr->is_store() && instr->get_operand(1) == alloca)
+      return true;
+    if (instr->is_load() && instr->get_operand(0) == alloca)
+      return false;
+  }
+  return false;
+}
+
+void Mem2Reg::insertPhi(Function *foo) {
+  for (auto alloca : promotable) {
+    std::set<BasicBlock *> defBlocks, hasPhi;
+    for (auto use : alloca->use_list_) {
+      auto instr = static_cast<Instruction *>(use.val_);
+      if (instr->is_store())
+        defBlocks.insert(instr->parent_);
+    }
+    std::vector<BasicBlock *> workList(defBlocks.begin(), defBlocks.end());
+    while (!workList.empty()) {
+      auto bb = workList.back();
+      workList.pop_back();
+      for (auto frontier : bb->dom_frontier_) {
+        if (!hasPhi.insert(frontier).second)
+          continue;
+        auto phi = PhiInst::create_phi(alloca->alloca_ty_, frontier);
+        frontier->add_instruction_front(phi);
+        phiAlloca[phi] = alloca;
+        if (!defBlocks.count(frontier))
+          workList.push_back(frontier);
+      }
+    }
+  }
+}
+
+Value *Mem2Reg::getUndef(AllocaInst *alloca) {
+  if (alloca->alloca_ty_->tid_ == Type::FloatTyID)
+    return m->get_const_float(0);
+  assert(alloca->alloca_ty_->tid_ == Type::IntegerTyID);
+  return m->get_const_int(m->int32_ty_, 0);
+}
+
+void Mem2Reg::rename(BasicBlock *bb) {
+  auto top = [&](AllocaInst *alloca) -> Value * {
+    auto &stack = valueStack[alloca];
+    if (stack.empty())
+      stack.push_back(getUndef(alloca));
+    return stack.back();
+  };
+  std::vector<AllocaInst *> pushed;
+  for (auto instr : bb->instr_list_) {
+    if (instr->is_phi()) {
+      auto iter = phiAlloca.find(instr);
+      if (iter != phiAlloca.end()) {
+        valueStack[iter->second].push_back(instr);
+        pushed.push_back(iter->second);
+      }
+    } else if (instr->is_load()) {
+      auto alloca = dynamic_cast<AllocaInst *>(instr->get_operand(0));
+      if (alloca && promotable.count(alloca)) {
+        instr->replace_all_use_with(top(alloca));
+        uselessInstr.push_back(instr);
+      }
+    } else if (instr->is_store()) {
+      auto alloca = dynamic_cast<AllocaInst *>(instr->get_operand(1));
+      if (alloca && promotable.count(alloca)) {
+        valueStack[alloca].push_back(instr->get_operand(0));
+        pushed.push_back(alloca);
+        uselessInstr.push_back(instr);
+      }
+    }
+  }
+  for (auto succ : bb->succ_bbs_)
+    for (auto instr : succ->instr_list_) {
+      if (!instr->is_phi())
+        break;
+      auto iter = phiAlloca.find(instr);
+      if (iter != phiAlloca.end())
+        static_cast<PhiInst *>(instr)->add_phi_pair_operand(top(iter->second),
+                                                            bb);
+    }
+  for (auto child : domChildren[bb])
+    rename(child);
+  for (auto alloca : pushed)
+    valueStack[alloca].pop_back();
+}
+
+// 删除没有被非 phi 指令使用的 phi，以及所有入值相同的 phi
+void Mem2Reg::deleteUselessPhi(Function *foo) {
+  std::set<Instruction *> livePhi;
+  std::vector<Instruction *> workList;
+  for (auto [phi, alloca] : phiAlloca)
+    for (auto use : phi->use_list_)
+      if (!phiAlloca.count(static_cast<Instruction *>(use.val_))) {
+        livePhi.insert(phi);
+        workList.push_back(phi);
+        break;
+      }
+  while (!workList.empty()) {
+    auto phi = workList.back();
+    workList.pop_back();
+    for (int i = 0; i < phi->num_ops_; i += 2) {
+      auto op = dynamic_cast<Instruction *>(phi->get_operand(i));
+      if (op && phiAlloca.count(op) && livePhi.insert(op).second)
+        workList.push_back(op);
+    }
+  }
+  for (auto [phi, alloca] : phiAlloca)
+    if (!livePhi.count(phi))
+      phi->parent_->delete_instr(phi);
+
+  bool change = true;
+  while (change) {
+    change = false;
+    for (auto phi : livePhi) {
+      if (phi->parent_ == nullptr)
+        continue;
+      Value *only = nullptr;
+      bool trivial = true;
+      for (int i = 0; i < phi->num_ops_; i += 2) {
+        auto op = phi->get_operand(i);
+        if (op == phi || op == only)
+          continue;
+        if (only != nullptr) {
+          trivial = false;
+          break;
+        }
+        only = op;
+      }
+      if (!trivial || only == nullptr)
+        continue;
+      phi->replace_all_use_with(only);
+      phi->parent_->delete_instr(phi);
+      change = true;
+    }
+  }
+}
@@ -0,0 +1,26 @@
+#ifndef MEM2REGH
+#define MEM2REGH
+
+#include "BasicOperation.h"
+
+// 将只被 load/store 访问的标量 alloca 提升为 SSA 值：
+// 在迭代支配边界处放置 phi，再沿支配树重命名。
+class Mem2Reg : public FunctionPass {
+  std::set<AllocaInst *> promotable;
+  std::map<Instruction *, AllocaInst *> phiAlloca;
+  std::map<AllocaInst *, std::vector<Value *>> valueStack;
+  std::map<BasicBlock *, std::vector<BasicBlock *>> domChildren;
+  std::vector<Instruction *> uselessInstr;
+
+public:
+  Mem2Reg(Module *m) : FunctionPass(m) {}
+  void runOnFunction(Function *foo);
+  int preserved() { return ALL_ANALYSIS; }
+  bool isPromotable(Function *foo, AllocaInst *alloca);
+  void insertPhi(Function *foo);
+  void rename(BasicBlock *bb);
+  Value *getUndef(AllocaInst *alloca);
+  void deleteUselessPhi(Function *foo);
+};
+
+#endif // !MEM2REGH
@@ -0,0 +1,155 @@
+#include "MemoryOpt.h"
+#include "utils.h"
+#include <algorithm>
+
+void MemoryOpt::runOnFunction(Function *foo) {
+  forwardCnt = deleteCnt = 0;
+  requireAnalysis(foo, DOMINATOR);
+  forwardLoads(foo);
+  for (auto bb : foo->basic_blocks_)
+    deleteOverwrittenStores(bb);
+  deleteUnreadAllocas(foo);
+  addStat("mem-opt.forwarded-loads", forwardCnt);
+  addStat("mem-opt.deleted-stores", deleteCnt);
+}
+
+void MemoryOpt::forwardLoads(Function *foo) {
+  MemorySSA mssa(foo, aa);
+  // 支配树先序：支配者中的 load 先被记录
+  std::map<BasicBlock *, std::vector<BasicBlock *>> domChildren;
+  std::set<BasicBlock *> reachable;
+  auto entry = foo->basic_blocks_.front();
+  dfsGraph(entry, reachable);
+  for (auto bb : foo->basic_blocks_)
+    if (bb != entry && reachable.count(bb))
+      domChildren[bb->idom_].push_back(bb);
+  std::vector<BasicBlock *> order = {entry};
+  for (int i = 0; i < order.size(); i++)
+    for (auto child : domChildren[order[i]])
+      order.push_back(child);
+
+  std::map<std::pair<MemoryAccess *, Value *>, std::vector<Instruction *>>
+      loads;
+  for (auto bb : order) {
+    std::vector<Instruction *> forwarded;
+    for (auto instr : bb->instr_list_) {
+      if (!instr->is_load())
+        continue;
+      auto ptr = instr->get_operand(0);
+      auto clobber = mssa.getClobber(mssa.getAccess(instr), ptr);
+      Value *val = getStoredValue(clobber, instr);
+      auto &prev = loads[{clobber, ptr}];
+      for (auto load : prev)
+        if (val == nullptr &&
+            (load->parent_ == bb || load->parent_->isDominate(bb) == 1))
+          val = load;
+      if (val == nullptr) {
+        prev.push_back(instr);
+        continue;
+      }
+      instr->replace_all_use_with(val);
+      forwarded.push_back(instr);
+    }
+    for (auto instr : forwarded)
+      bb->delete_instr(instr);
+    forwardCnt += forwarded.size();
+  }
+}
+
+Value *MemoryOpt::getStoredValue(MemoryAccess *clobber, Instruction *load) {
+  if (clobber->kind != MemoryAccess::Def)
+    return nullptr;
+  auto def = clobber->instr;
+  auto ptr = load->get_operand(0);
+  if (def->is_store()) {
+    auto val = def->get_operand(0);
+    if (aa->alias(def->get_operand(1), ptr) == MustAlias &&
+        val->type_ == load->type_)
+      return val;
+    return nullptr;
+  }
+  // memclr 将局部数组整个清零
+  auto callee = static_cast<Function *>(def->get_operand(def->num_ops_ - 1));
+  auto alloca = dynamic_cast<AllocaInst *>(getBasePtr(ptr));
+  if (callee->name_ != "__aeabi_memclr4" || alloca == nullptr ||
+      getBasePtr(def->get_operand(0)) != alloca)
+    return nullptr;
+  auto bytes = dynamic_cast<ConstantInt *>(def->get_operand(1));
+  int size = 4;
+  for (auto ty = alloca->alloca_ty_; ty->tid_ == Type::ArrayTyID;
+       ty = static_cast<ArrayType *>(ty)->contained_)
+    size *= static_cast<ArrayType *>(ty)->num_elements_;
+  if (bytes == nullptr || bytes->value_ < size)
+    return nullptr;
+  if (load->type_ == m->int32_ty_)
+    return m->get_const_int(m->int32_ty_, 0);
+  if (load->type_ == m->float32_ty_)
+    return m->get_const_float(0);
+  return nullptr;
+}
+
+// 逆序扫描，记录之后会在被读取之前被写入的地址
+void MemoryOpt::deleteOverwrittenStores(BasicBlock *bb) {
+  std::vector<Value *> killed;
+  std::vector<Instruction *> deadStores;
+  for (auto iter = bb->instr_list_.rbegin(); iter != bb->instr_list_.rend();
+       iter++) {
+    auto instr = *iter;
+    if (instr->is_store()) {
+      auto ptr = instr->get_operand(1);
+      if (std::any_of(killed.begin(), killed.end(), [&](Value *val) {
+            return aa->alias(val, ptr) == MustAlias;
+          }))
+        deadStores.push_back(instr);
+      else
+        killed.push_back(ptr);
+    } else if (instr->is_load() || instr->is_call())
+      killed.erase(std::remove_if(killed.begin(), killed.end(),
+                                  [&](Value *val) {
+                                    return aa->mayAccess(instr, val, false);
+                                  }),
+                   killed.end());
+  }
+  for (auto store : deadStores)
+    bb->delete_instr(store);
+  deleteCnt += deadStores.size();
+}
+
+bool MemoryOpt::collectWriteOnlyUsers(Value *ptr,
+                                      std::vector<Instruction *> &users) {
+  for (auto &use : ptr->use_list_) {
+    auto instr = static_cast<Instruction *>(use.val_);
+    if (instr->is_gep() || instr->op_id_ == Instruction::BitCast) {
+      users.push_back(instr);
+      if (!collectWriteOnlyUsers(instr, users))
+        return false;
+    } else if (instr->is_store() && use.arg_no_ == 1)
+      users.push_back(instr);
+    else if (instr->is_call() && use.arg_no_ == 0 &&
+             instr->get_operand(instr->num_ops_ - 1)->name_ ==
+                 "__aeabi_memclr4")
+      users.push_back(instr);
+    else
+      return false;
+  }
+  return true;
+}
+
+void MemoryOpt::deleteUnreadAllocas(Function *foo) {
+  std::vector<Instruction *> allocas;
+  for (auto bb : foo->basic_blocks_)
+    for (auto instr : bb->instr_list_)
+      if (instr->is_alloca())
+        allocas.push_back(instr);
+  for (auto alloca : allocas) {
+    std::vector<Instruction *> users;
+    if (!collectWriteOnlyUsers(alloca, users))
+      continue;
+    // 先删除使用者，再删除其地址操作数
+    for (auto iter = users.rbegin(); iter != users.rend(); iter++) {
+      deleteCnt += (*iter)->is_store();
+      (*iter)->parent_->delete_instr(*iter);
+    }
+    alloca->parent_->delete_instr(alloca);
+  }
+}
@@ -0,0 +1,32 @@
+#ifndef MEMORYOPTH
+#define MEMORYOPTH
+
+#include "MemorySSA.h"
+
+// 基于内存 SSA 的冗余访存删除：
+// 1. load 之前最后一次可能写入该地址的是对同一地址的 store 时，
+//    直接使用写入的值，是将整个局部数组清零的 memclr 时使用 0；
+// 2. 地址相同且之前最后一次可能的写入也相同的两个 load，
+//    被支配的一个使用前者的结果；
+// 3. 同一块中在被读取之前就被覆盖的 store 删除；
+// 4. 从未被读取的局部数组连同对它的写入一起删除。
+class MemoryOpt : public FunctionPass {
+  int forwardCnt, deleteCnt;
+
+public:
+  MemoryOpt(Module *m) : FunctionPass(m) {}
+  void runOnFunction(Function *foo);
+  int required() { return DOMINATOR; }
+  int requiredModule() { return ALIAS_ANALYSIS; }
+  int preserved() { return ALL_ANALYSIS; }
+  void forwardLoads(Function *foo);
+  // clobber 写入 load 所读地址的值，无法确定时返回空
+  Value *getStoredValue(MemoryAccess *clobber, Instruction *load);
+  void deleteOverwrittenStores(BasicBlock *bb);
+  void deleteUnreadAllocas(Function *foo);
+  // 收集 ptr 经 getelementptr 与 bitcast 得到的地址上的全部使用，
+  // 存在读取或逃逸（传给会读取它的函数等）时返回 false
+  bool collectWriteOnlyUsers(Value *ptr, std::vector<Instruction *> &users);
+};
+
+#endif // !MEMORYOPTH
@@ -0,0 +1,111 @@
+#include "MemorySSA.h"
+
+MemorySSA::MemorySSA(Function *foo, AliasAnalysis *aa_) : aa(aa_) {
+  entry = foo->basic_blocks_.front();
+  std::set<BasicBlock *> reachable;
+  dfsGraph(entry, reachable);
+  for (auto bb : foo->basic_blocks_) {
+    if (!reachable.count(bb))
+      continue;
+    if (bb != entry)
+      domChildren[bb->idom_].push_back(bb);
+    if (bb->pre_bbs_.size() > 1)
+      phiOf[bb] = newAccess(MemoryAccess::Phi, nullptr);
+  }
+  liveOnEntry = newAccess(MemoryAccess::LiveOnEntry, nullptr);
+  build(entry, liveOnEntry);
+  // 不可达的前驱不影响内存状态；被块支配的前驱经回边到达
+  for (auto [bb, phi] : phiOf) {
+    phi->block = bb;
+    for (auto pre : bb->pre_bbs_)
+      if (endOf.count(pre)) {
+        phi->incoming.push_back(endOf[pre]);
+        phi->backEdge.push_back(pre == bb || bb->isDominate(pre) == 1);
+      }
+  }
+}
+
+MemorySSA::~MemorySSA() {
+  for (auto acc : accesses)
+    delete acc;
+}
+
+MemoryAccess *MemorySSA::newAccess(MemoryAccess::Kind kind,
+                                   Instruction *instr) {
+  auto acc = new MemoryAccess(kind, instr);
+  accesses.push_back(acc);
+  if (instr)
+    accessOf[instr] = acc;
+  return acc;
+}
+
+// 沿支配树先序遍历：单前驱块的前驱即直接支配者，入口状态为其末尾状态
+void MemorySSA::build(BasicBlock *bb, MemoryAccess *cur) {
+  if (phiOf.count(bb))
+    cur = phiOf[bb];
+  for (auto instr : bb->instr_list_) {
+    MemoryAccess *acc = nullptr;
+    if (instr->is_store() || (instr->is_call() && aa->callMayWrite(instr)))
+      acc = newAccess(MemoryAccess::Def, instr);
+    else if (instr->is_load() || (instr->is_call() && aa->callMayRead(instr)))
+      acc = newAccess(MemoryAccess::Use, instr);
+    if (acc == nullptr)
+      continue;
+    acc->defining = cur;
+    if (acc->kind == MemoryAccess::Def)
+      cur = acc;
+  }
+  endOf[bb] = cur;
+  for (auto child : domChildren[bb])
+    build(child, cur);
+}
+
+MemoryAccess *MemorySSA::getAccess(Instruction *instr) {
+  auto iter = accessOf.find(instr);
+  return iter == accessOf.end() ? nullptr : iter->second;
+}
+
+MemoryAccess *MemorySSA::getClobber(MemoryAccess *acc, Value *ptr) {
+  visited.clear();
+  return walk(acc->defining, ptr, nullptr);
+}
+
+// 经过 Phi 时分别查找各前驱，回到正在查找的 Phi 的路径上没有写入，不影响结果。
+// 经过回边后找到的写入属于循环之前的迭代，crossLoop 取已经过的循环中最外层的
+// 循环头；互不支配时取函数入口，视所有值都可能不同
+MemoryAccess *MemorySSA::walk(MemoryAccess *acc, Value *ptr,
+                              BasicBlock *crossLoop) {
+  while (acc->kind == MemoryAccess::Def &&
+         !aa->mayAccess(acc->instr, ptr, true, crossLoop))
+    acc = acc->defining;
+  if (acc->kind != MemoryAccess::Phi)
+    return acc;
+  auto key = std::make_pair(acc, crossLoop);
+  auto iter = visited.find(key);
+  if (iter != visited.end())
+    return iter->second;
+  visited[key] = nullptr;
+  MemoryAccess *res = nullptr;
+  for (int i = 0; i < acc->incoming.size(); i++) {
+    auto loop = crossLoop;
+    auto header = acc->block;
+    if (acc->backEdge[i] && loop != header) {
+      if (loop == nullptr || header->isDominate(loop) == 1)
+        loop = header;
+      else if (loop->isDominate(header) != 1)
+        loop = entry;
+    }
+    auto clobber = walk(acc->incoming[i], ptr, loop);
+    if (clobber == nullptr || clobber == res)
+      continue;
+    if (res != nullptr) {
+      res = acc;
+      break;
+    }
+    res = clobber;
+  }
+  if (res == nullptr)
+    res = acc;
+  visited[key] = res;
+  return res;
+}
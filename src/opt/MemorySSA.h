@@ -0,0 +1,47 @@
+#ifndef MEMORYSSAH
+#define MEMORYSSAH
+
+#include "AliasAnalysis.h"
+
+// 内存访问：store 与可能写内存的调用为 Def，load 与只读内存的调用为 Use，
+// 有多个前驱的块入口为 Phi，函数入口的内存状态为 LiveOnEntry
+class MemoryAccess {
+public:
+  enum Kind { LiveOnEntry, Def, Use, Phi } kind;
+  Instruction *instr;                   // Def 与 Use 对应的指令
+  MemoryAccess *defining = nullptr;     // Def 与 Use 之前最近的 Def 或 Phi
+  std::vector<MemoryAccess *> incoming; // Phi 各前驱末尾的内存状态
+  std::vector<bool> backEdge;           // 对应的前驱是否经回边到达
+  BasicBlock *block = nullptr;          // Phi 所在的块
+
+  MemoryAccess(Kind kind_, Instruction *instr_ = nullptr)
+      : kind(kind_), instr(instr_) {}
+};
+
+// 简化的内存 SSA：不区分内存位置，所有写入构成一条 Def 链，
+// 查询某个地址时沿链跳过不会写入该地址的 Def。需要有效的支配树。
+class MemorySSA {
+  AliasAnalysis *aa;
+  std::vector<MemoryAccess *> accesses;
+  std::map<Instruction *, MemoryAccess *> accessOf;
+  std::map<BasicBlock *, MemoryAccess *> phiOf, endOf;
+  std::map<BasicBlock *, std::vector<BasicBlock *>> domChildren;
+  BasicBlock *entry;
+  MemoryAccess *liveOnEntry;
+  // 一次查询中已经处理（正在处理时为空）的 Phi，区分已经过回边的循环
+  std::map<std::pair<MemoryAccess *, BasicBlock *>, MemoryAccess *> visited;
+
+  MemoryAccess *newAccess(MemoryAccess::Kind kind, Instruction *instr);
+  void build(BasicBlock *bb, MemoryAccess *cur);
+  MemoryAccess *walk(MemoryAccess *acc, Value *ptr, BasicBlock *crossLoop);
+
+public:
+  MemorySSA(Function *foo, AliasAnalysis *aa_);
+  ~MemorySSA();
+  // 不读写内存的指令返回空
+  MemoryAccess *getAccess(Instruction *instr);
+  // 在 acc 之前最后一次可能写入 ptr 的访问。各路径上的结果不同时返回合流的 Phi
+  MemoryAccess *getClobber(MemoryAccess *acc, Value *ptr);
+};
+
+#endif // !MEMORYSSAH
@@ -0,0 +1,132 @@
+#include "PassManager.h"
+#include "AliasAnalysis.h"
+#include "CombineInstr.h"
+#include "ConstSpread.h"
+#include "DeleteDeadCode.h"
+#include "GVN.h"
+#include "InductionVariable.h"
+#include "Inline.h"
+#include "LoopInvariant.h"
+#include "LoopUnroll.h"
+#include "Mem2Reg.h"
+#include "MemoryOpt.h"
+#include "SCCP.h"
+#include "SimplifyJump.h"
+#include "TailRecursion.h"
+#include "utils.h"
+#include <iostream>
+#include <sstream>
+
+const std::map<std::string, std::function<Optimization *(Module *)>>
+    PassManager::registry = {
+        {"mem2reg", [](Module *m) { return new Mem2Reg(m); }},
+        {"tre", [](Module *m) { return new TailRecursionElim(m); }},
+        {"inline", [](Module *m) { return new Inline(m); }},
+        {"dce", [](Module *m) { return new DeadCodeDeletion(m); }},
+        {"const-spread", [](Module *m) { return new ConstSpread(m); }},
+        {"sccp", [](Module *m) { return new SCCP(m); }},
+        {"gvn", [](Module *m) { return new GVN(m); }},
+        {"combine-instr", [](Module *m) { return new CombineInstr(m); }},
+        {"simplify-jump", [](Module *m) { return new SimplifyJump(m); }},
+        {"loop-invariant", [](Module *m) { return new LoopInvariant(m); }},
+        {"indvars", [](Module *m) { return new InductionVariable(m); }},
+        {"unroll", [](Module *m) { return new LoopUnroll(m); }},
+        {"mem-opt", [](Module *m) { return new MemoryOpt(m); }},
+};
+
+PassManager::~PassManager() {
+  for (auto &[name, pass] : passes)
+    delete pass;
+}
+
+void PassManager::addPass(const std::string &name, Optimization *pass) {
+  pass->am = &am;
+  passes.push_back({name, pass});
+}
+
+bool PassManager::addPass(const std::string &name) {
+  auto iter = registry.find(name);
+  if (iter == registry.end())
+    return false;
+  addPass(name, iter->second(m));
+  return true;
+}
+
+bool PassManager::parsePipeline(const std::string &pipeline) {
+  std::stringstream ss(pipeline);
+  std::string name;
+  while (std::getline(ss, name, ','))
+    if (!name.empty() && !addPass(name)) {
+      std::cerr << "unknown pass: " << name << std::endl;
+      return false;
+    }
+  return true;
+}
+
+void PassManager::addDefaultPipeline() {
+  parsePipeline("mem2reg,tre,inline,dce,sccp,combine-instr,gvn,mem-opt,"
+                "simplify-jump,loop-invariant,unroll,sccp,combine-instr,gvn,"
+                "mem-opt,indvars,simplify-jump");
+}
+
+bool PassManager::isFunctionPass(int i) {
+  return dynamic_cast<FunctionPass *>(passes[i].second) != nullptr &&
+         registry.count(passes[i].first);
+}
+
+void PassManager::run() {
+  for (int i = 0; i < passes.size();) {
+    if (jobs > 0 && isFunctionPass(i)) {
+      int end = i;
+      while (end < passes.size() && isFunctionPass(end))
+        end++;
+      runFunctionPasses(i, end);
+      i = end;
+      continue;
+    }
+    auto &[name, pass] = passes[i++];
+    PhaseTimer timer("opt." + name);
+    if (pass->required())
+      for (auto foo : m->function_list_)
+        am.require(foo, pass->required());
+    pass->execute();
+    am.invalidateExcept(pass->preserved());
+  }
+}
+
+// 过程间分析在同步点计算一次，段内只读：函数级 pass 只会删除或复制已有的
+// 访存与调用，副作用摘要与实参所指对象仍然是安全的近似
+void PassManager::runFunctionPasses(int begin, int end) {
+  int modules = 0;
+  for (int i = begin; i < end; i++)
+    modules |= static_cast<FunctionPass *>(passes[i].second)->requiredModule();
+  FuncInfo *info = nullptr;
+  AliasAnalysis *aa = nullptr;
+  if (modules & (FUNC_INFO | ALIAS_ANALYSIS))
+    info = new FuncInfo(m);
+  if (modules & ALIAS_ANALYSIS)
+    aa = new AliasAnalysis(m, info);
+
+  std::vector<Function *> functions;
+  for (auto foo : m->function_list_)
+    if (!foo->basic_blocks_.empty())
+      functions.push_back(foo);
+  // 每个函数使用新的 pass 对象，成员变量不在线程之间共享
+  getThreadPool().run(functions.size(), [&](int k) {
+    auto foo = functions[k];
+    for (int i = begin; i < end; i++) {
+      auto &name = passes[i].first;
+      PhaseTimer timer("opt." + name);
+      auto pass = static_cast<FunctionPass *>(registry.at(name)(m));
+      pass->am = &am;
+      pass->info = info;
+      pass->aa = aa;
+      am.require(foo, pass->required());
+      pass->runOnFunction(foo);
+      am.invalidate(foo, ALL_ANALYSIS & ~pass->preserved());
+      delete pass;
+    }
+  });
+  delete aa;
+  delete info;
+}
@@ -0,0 +1,41 @@
+#ifndef PASSMANAGERH
+#define PASSMANAGERH
+
+#include "opt.h"
+#include <functional>
+#include <string>
+
+// 按顺序运行各个 pass：运行前保证其所需的分析有效，
+// 运行后只保留其声明保留的分析，使其余分析在下次使用前重新计算。
+// -j 模式下连续的函数级 pass 组成一段流水线，各函数在工作线程中依次运行
+// 整段流水线；模块级 pass 是同步点，在全部函数完成前一段之后才运行。
+class PassManager {
+  Module *m;
+  AnalysisManager am;
+  std::vector<std::pair<std::string, Optimization *>> passes;
+
+  // 可以逐函数并行运行：函数级 pass，且能为每个函数单独创建
+  bool isFunctionPass(int i);
+  // 在全部函数上并行运行第 begin 到 end - 1 个 pass
+  void runFunctionPasses(int begin, int end);
+
+public:
+  // 大于 0 时按函数并行运行流水线，为 0 时依次对全部函数运行每个 pass
+  int jobs = 0;
+
+  explicit PassManager(Module *m_) : m(m_), am(m_) {}
+  ~PassManager();
+  void addPass(const std::string &name, Optimization *pass);
+  // 按名称添加 pass，名称未知时返回 false
+  bool addPass(const std::string &name);
+  // 解析以逗号分隔的 pass 名称列表，如 "mem2reg,dce,sccp"
+  bool parsePipeline(const std::string &pipeline);
+  // -O1 使用的默认流水线
+  void addDefaultPipeline();
+  void run();
+
+  static const std::map<std::string, std::function<Optimization *(Module *)>>
+      registry;
+};
+
+#endif // !PASSMANAGERH
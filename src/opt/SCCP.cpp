@@ -0,0 +1,423 @@
+#include "SCCP.h"
+#include "utils.h"
+#include <climits>
+#include <cmath>
+
+void SCCP::runOnFunction(Function *foo) {
+  lattice.clear();
+  executableBlocks.clear();
+  executableEdges.clear();
+  cfgWorkList.clear();
+  ssaWorkList.clear();
+  solve(foo);
+  rewrite(foo);
+}
+
+SCCP::LatticeValue SCCP::getValue(Value *val) {
+  LatticeValue res;
+  if (dynamic_cast<ConstantInt *>(val) || dynamic_cast<ConstantFloat *>(val)) {
+    res.state = LatticeValue::CONST;
+    res.val = static_cast<Constant *>(val);
+  } else if (dynamic_cast<Instruction *>(val) == nullptr)
+    // 形参、全局变量等
+    res.state = LatticeValue::OVERDEF;
+  else {
+    auto iter = lattice.find(val);
+    if (iter != lattice.end())
+      res = iter->second;
+  }
+  return res;
+}
+
+// 格值只会单调上升，每次上升时将使用者加入 SSA 工作表
+void SCCP::markConst(Instruction *instr, Constant *val) {
+  auto &cur = lattice[instr];
+  if (cur.state != LatticeValue::UNDEF)
+    return;
+  cur.state = LatticeValue::CONST;
+  cur.val = val;
+  ssaWorkList.push_back(instr);
+}
+
+void SCCP::markOverdef(Instruction *instr) {
+  auto &cur = lattice[instr];
+  if (cur.state == LatticeValue::OVERDEF)
+    return;
+  cur.state = LatticeValue::OVERDEF;
+  cur.val = nullptr;
+  ssaWorkList.push_back(instr);
+}
+
+void SCCP::markEdge(BasicBlock *from, BasicBlock *to) {
+  if (executableEdges.insert({from, to}).second)
+    cfgWorkList.push_back({from, to});
+}
+
+void SCCP::solve(Function *foo) {
+  auto entry = foo->basic_blocks_.front();
+  executableBlocks.insert(entry);
+  for (auto instr : entry->instr_list_)
+    visitInstr(instr);
+  while (true) {
+    while (!cfgWorkList.empty() || !ssaWorkList.empty()) {
+      while (!cfgWorkList.empty()) {
+        auto [from, to] = cfgWorkList.back();
+        cfgWorkList.pop_back();
+        if (executableBlocks.insert(to).second) {
+          for (auto instr : to->instr_list_)
+            visitInstr(instr);
+        } else
+          // 已访问过的块只有 phi 会因新的入边改变
+          for (auto instr : to->instr_list_) {
+            if (!instr->is_phi())
+              break;
+            visitPhi(instr);
+          }
+      }
+      while (!ssaWorkList.empty()) {
+        auto instr = ssaWorkList.back();
+        ssaWorkList.pop_back();
+        for (auto &use : instr->use_list_) {
+          auto user = dynamic_cast<Instruction *>(use.val_);
+          if (user && executableBlocks.count(user->parent_))
+            visitInstr(user);
+        }
+      }
+    }
+    // 条件仍未确定的分支（仅由未定义值导出）按非常量处理，保证结果可靠
+    bool resolved = false;
+    for (auto bb : executableBlocks) {
+      auto br = bb->get_terminator();
+      if (br && br->is_br() && br->num_ops_ == 3 &&
+          getValue(br->get_operand(0)).state == LatticeValue::UNDEF) {
+        auto cond = dynamic_cast<Instruction *>(br->get_operand(0));
+        if (cond)
+          markOverdef(cond);
+        markEdge(bb, static_cast<BasicBlock *>(br->get_operand(1)));
+        markEdge(bb, static_cast<BasicBlock *>(br->get_operand(2)));
+        resolved = true;
+      }
+    }
+    if (!resolved)
+      break;
+  }
+}
+
+void SCCP::visitInstr(Instruction *instr) {
+  if (instr->is_phi()) {
+    visitPhi(instr);
+    return;
+  }
+  if (instr->is_br()) {
+    visitBranch(instr);
+    return;
+  }
+  if (instr->is_void())
+    return;
+  switch (instr->op_id_) {
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::SDiv:
+  case Instruction::SRem:
+  case Instruction::UDiv:
+  case Instruction::URem:
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+  case Instruction::FAdd:
+  case Instruction::FSub:
+  case Instruction::FMul:
+  case Instruction::FDiv:
+  case Instruction::FNeg:
+  case Instruction::ICmp:
+  case Instruction::FCmp:
+  case Instruction::ZExt:
+  case Instruction::FPtoSI:
+  case Instruction::SItoFP:
+    break;
+  default:
+    // 访存、调用与地址计算的结果无法在编译期确定
+    markOverdef(instr);
+    return;
+  }
+  for (auto op : instr->operands_) {
+    auto state = getValue(op).state;
+    if (state == LatticeValue::OVERDEF) {
+      markOverdef(instr);
+      return;
+    }
+    if (state == LatticeValue::UNDEF)
+      return;
+  }
+  auto res = fold(instr);
+  if (res)
+    markConst(instr, res);
+  else
+    markOverdef(instr);
+}
+
+// 只合并来自可执行边的入值
+void SCCP::visitPhi(Instruction *phi) {
+  if (getValue(phi).state == LatticeValue::OVERDEF)
+    return;
+  Constant *only = nullptr;
+  for (int i = 0; i < phi->num_ops_; i += 2) {
+    auto pre = static_cast<BasicBlock *>(phi->get_operand(i + 1));
+    if (!executableEdges.count({pre, phi->parent_}))
+      continue;
+    auto val = getValue(phi->get_operand(i));
+    if (val.state == LatticeValue::UNDEF)
+      continue;
+    if (val.state == LatticeValue::OVERDEF) {
+      markOverdef(phi);
+      return;
+    }
+    if (only == nullptr)
+      only = val.val;
+    else if (!sameConst(only, val.val)) {
+      markOverdef(phi);
+      return;
+    }
+  }
+  if (only != nullptr)
+    markConst(phi, only);
+}
+
+void SCCP::visitBranch(Instruction *br) {
+  auto bb = br->parent_;
+  if (br->num_ops_ == 1) {
+    markEdge(bb, static_cast<BasicBlock *>(br->get_operand(0)));
+    return;
+  }
+  auto trueBB = static_cast<BasicBlock *>(br->get_operand(1));
+  auto falseBB = static_cast<BasicBlock *>(br->get_operand(2));
+  auto cond = getValue(br->get_operand(0));
+  if (cond.state == LatticeValue::UNDEF)
+    return;
+  if (cond.state == LatticeValue::OVERDEF) {
+    markEdge(bb, trueBB);
+    markEdge(bb, falseBB);
+  } else if (static_cast<ConstantInt *>(cond.val)->value_)
+    markEdge(bb, trueBB);
+  else
+    markEdge(bb, falseBB);
+}
+
+bool SCCP::sameConst(Constant *a, Constant *b) {
+  auto ia = dynamic_cast<ConstantInt *>(a), ib = dynamic_cast<ConstantInt *>(b);
+  if (ia && ib)
+    return ia->value_ == ib->value_;
+  auto fa = dynamic_cast<ConstantFloat *>(a),
+       fb = dynamic_cast<ConstantFloat *>(b);
+  // 按位比较，以区分 0.0 与 -0.0
+  return fa && fb &&
+         std::signbit(fa->value_) == std::signbit(fb->value_) &&
+         fa->value_ == fb->value_;
+}
+
+Constant *SCCP::fold(Instruction *instr) {
+  auto intOp = [&](int i) {
+    return static_cast<ConstantInt *>(getValue(instr->get_operand(i)).val)
+        ->value_;
+  };
+  auto floatOp = [&](int i) {
+    return static_cast<ConstantFloat *>(getValue(instr->get_operand(i)).val)
+        ->value_;
+  };
+  auto makeInt = [&](long long val) -> Constant * {
+    return m->get_const_int(instr->type_, static_cast<int>(val));
+  };
+  auto makeFloat = [&](float val) -> Constant * {
+    return m->get_const_float(val);
+  };
+  switch (instr->op_id_) {
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::SDiv:
+  case Instruction::SRem:
+  case Instruction::UDiv:
+  case Instruction::URem:
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor: {
+    // 以无符号数计算，溢出时按 32 位回绕，与目标机器一致
+    int a = intOp(0), b = intOp(1);
+    unsigned ua = a, ub = b;
+    switch (instr->op_id_) {
+    case Instruction::Add:
+      return makeInt(static_cast<int>(ua + ub));
+    case Instruction::Sub:
+      return makeInt(static_cast<int>(ua - ub));
+    case Instruction::Mul:
+      return makeInt(static_cast<int>(ua * ub));
+    case Instruction::SDiv:
+      if (b == 0)
+        return nullptr;
+      return makeInt(a == INT_MIN && b == -1 ? a : a / b);
+    case Instruction::SRem:
+      if (b == 0)
+        return nullptr;
+      return makeInt(a == INT_MIN && b == -1 ? 0 : a % b);
+    case Instruction::UDiv:
+      return b == 0 ? nullptr : makeInt(static_cast<int>(ua / ub));
+    case Instruction::URem:
+      return b == 0 ? nullptr : makeInt(static_cast<int>(ua % ub));
+    case Instruction::Shl:
+      return makeInt(static_cast<int>(ua << (ub & 31)));
+    case Instruction::LShr:
+      return makeInt(static_cast<int>(ua >> (ub & 31)));
+    case Instruction::AShr:
+      return makeInt(a >> (ub & 31));
+    case Instruction::And:
+      return makeInt(a & b);
+    case Instruction::Or:
+      return makeInt(a | b);
+    default:
+      return makeInt(a ^ b);
+    }
+  }
+  case Instruction::FAdd:
+    return makeFloat(floatOp(0) + floatOp(1));
+  case Instruction::FSub:
+    return makeFloat(floatOp(0) - floatOp(1));
+  case Instruction::FMul:
+    return makeFloat(floatOp(0) * floatOp(1));
+  case Instruction::FDiv:
+    return makeFloat(floatOp(0) / floatOp(1));
+  case Instruction::FNeg:
+    return makeFloat(-floatOp(0));
+  case Instruction::ICmp: {
+    int a = intOp(0), b = intOp(1);
+    unsigned ua = a, ub = b;
+    switch (static_cast<ICmpInst *>(instr)->icmp_op_) {
+    case ICmpInst::ICMP_EQ:
+      return makeInt(a == b);
+    case ICmpInst::ICMP_NE:
+      return makeInt(a != b);
+    case ICmpInst::ICMP_UGT:
+      return makeInt(ua > ub);
+    case ICmpInst::ICMP_UGE:
+      return makeInt(ua >= ub);
+    case ICmpInst::ICMP_ULT:
+      return makeInt(ua < ub);
+    case ICmpInst::ICMP_ULE:
+      return makeInt(ua <= ub);
+    case ICmpInst::ICMP_SGT:
+      return makeInt(a > b);
+    case ICmpInst::ICMP_SGE:
+      return makeInt(a >= b);
+    case ICmpInst::ICMP_SLT:
+      return makeInt(a < b);
+    case ICmpInst::ICMP_SLE:
+      return makeInt(a <= b);
+    }
+    return nullptr;
+  }
+  case Instruction::FCmp: {
+    float a = floatOp(0), b = floatOp(1);
+    bool unordered = std::isnan(a) || std::isnan(b);
+    switch (static_cast<FCmpInst *>(instr)->fcmp_op_) {
+    case FCmpInst::FCMP_FALSE:
+      return makeInt(0);
+    case FCmpInst::FCMP_OEQ:
+      return makeInt(a == b);
+    case FCmpInst::FCMP_OGT:
+      return makeInt(a > b);
+    case FCmpInst::FCMP_OGE:
+      return makeInt(a >= b);
+    case FCmpInst::FCMP_OLT:
+      return makeInt(a < b);
+    case FCmpInst::FCMP_OLE:
+      return makeInt(a <= b);
+    case FCmpInst::FCMP_ONE:
+      return makeInt(!unordered && a != b);
+    case FCmpInst::FCMP_ORD:
+      return makeInt(!unordered);
+    case FCmpInst::FCMP_UNO:
+      return makeInt(unordered);
+    case FCmpInst::FCMP_UEQ:
+      return makeInt(unordered || a == b);
+    case FCmpInst::FCMP_UGT:
+      return makeInt(unordered || a > b);
+    case FCmpInst::FCMP_UGE:
+      return makeInt(unordered || a >= b);
+    case FCmpInst::FCMP_ULT:
+      return makeInt(unordered || a < b);
+    case FCmpInst::FCMP_ULE:
+      return makeInt(unordered || a <= b);
+    case FCmpInst::FCMP_UNE:
+      return makeInt(a != b);
+    case FCmpInst::FCMP_TRUE:
+      return makeInt(1);
+    }
+    return nullptr;
+  }
+  case Instruction::ZExt:
+    return makeInt(intOp(0));
+  case Instruction::FPtoSI: {
+    // 超出 int 范围的转换结果由目标机器决定，不做折叠
+    float a = floatOp(0);
+    if (!(a > -2147483904.0f && a < 2147483648.0f))
+      return nullptr;
+    return makeInt(static_cast<int>(a));
+  }
+  case Instruction::SItoFP:
+    return makeFloat(static_cast<float>(intOp(0)));
+  default:
+    return nullptr;
+  }
+}
+
+void SCCP::rewrite(Function *foo) {
+  int foldedInstrs = 0, foldedBranches = 0;
+  for (auto bb : foo->basic_blocks_) {
+    if (!executableBlocks.count(bb))
+      continue;
+    std::vector<Instruction *> folded;
+    for (auto instr : bb->instr_list_) {
+      auto val = getValue(instr);
+      if (val.state == LatticeValue::CONST) {
+        instr->replace_all_use_with(val.val);
+        folded.push_back(instr);
+      }
+    }
+    for (auto instr : folded)
+      bb->delete_instr(instr);
+    foldedInstrs += folded.size();
+  }
+  // 只有一条出边可执行的条件跳转改为无条件跳转
+  for (auto bb : foo->basic_blocks_) {
+    if (!executableBlocks.count(bb))
+      continue;
+    auto br = bb->get_terminator();
+    if (!br || !br->is_br() || br->num_ops_ != 3)
+      continue;
+    auto trueBB = static_cast<BasicBlock *>(br->get_operand(1));
+    auto falseBB = static_cast<BasicBlock *>(br->get_operand(2));
+    bool trueLive = executableEdges.count({bb, trueBB});
+    bool falseLive = executableEdges.count({bb, falseBB});
+    if (trueLive == falseLive)
+      continue;
+    auto target = trueLive ? trueBB : falseBB;
+    bb->delete_instr(br);
+    for (auto succ : bb->succ_bbs_) {
+      succ->remove_pre_basic_block(bb);
+      if (succ != target)
+        SolvePhi(bb, succ);
+    }
+    bb->succ_bbs_.clear();
+    new BranchInst(target, bb);
+    foldedBranches++;
+  }
+  DeleteUnusedBB(foo);
+  addStat("sccp.folded-instrs", foldedInstrs);
+  addStat("sccp.folded-branches", foldedBranches);
+}
@@ -0,0 +1,39 @@
+#ifndef SCCPH
+#define SCCPH
+
+#include "BasicOperation.h"
+
+// 稀疏条件常量传播（Wegman–Zadeck）：
+// 同时在可执行边与 SSA 边上迭代，只沿可执行边合并 phi 的入值，
+// 收敛后将常量代入使用处，并删除不可执行的分支与基本块。
+class SCCP : public FunctionPass {
+  // 格：UNDEF（尚未确定）< CONST < OVERDEF（非常量）
+  struct LatticeValue {
+    enum State { UNDEF, CONST, OVERDEF } state = UNDEF;
+    Constant *val = nullptr;
+  };
+  std::map<Value *, LatticeValue> lattice;
+  std::set<BasicBlock *> executableBlocks;
+  std::set<std::pair<BasicBlock *, BasicBlock *>> executableEdges;
+  std::vector<std::pair<BasicBlock *, BasicBlock *>> cfgWorkList;
+  std::vector<Instruction *> ssaWorkList;
+
+public:
+  SCCP(Module *m) : FunctionPass(m) {}
+  void runOnFunction(Function *foo);
+  void solve(Function *foo);
+  void rewrite(Function *foo);
+
+  LatticeValue getValue(Value *val);
+  void markConst(Instruction *instr, Constant *val);
+  void markOverdef(Instruction *instr);
+  void markEdge(BasicBlock *from, BasicBlock *to);
+  void visitInstr(Instruction *instr);
+  void visitPhi(Instruction *phi);
+  void visitBranch(Instruction *br);
+  bool sameConst(Constant *a, Constant *b);
+  // 所有操作数均为常量时计算结果，无法计算（如除以 0）时返回空
+  Constant *fold(Instruction *instr);
+};
+
+#endif // !SCCPH
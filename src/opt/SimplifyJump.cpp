@@ -1,4 +1,5 @@
 #include "SimplifyJump.h"
+#include "utils.h"
 
 void SimplifyJump::execute() {
   for (auto foo : m->function_list_)
@@ -70,6 +71,7 @@ void SimplifyJump::mergePreBlock(Function *foo) {
       uselessBlock.push_back(bb);
     }
   }
+  addStat("simplify-jump.merged-blocks", uselessBlock.size());
   deleteUselessBlock(foo, uselessBlock);
 }
 
@@ -0,0 +1,67 @@
+#include "TailRecursion.h"
+#include "utils.h"
+
+void TailRecursionElim::runOnFunction(Function *foo) {
+  int cnt = eliminate(foo);
+  if (cnt)
+    invalidateAnalysis(foo);
+  addStat("tre.eliminated-calls", cnt);
+}
+
+int TailRecursionElim::eliminate(Function *foo) {
+  std::vector<CallInst *> calls;
+  for (auto bb : foo->basic_blocks_)
+    for (auto instr : bb->instr_list_) {
+      // 局部数组的地址可能作为实参传入下一层，不能复用同一块栈空间
+      if (instr->is_alloca())
+        return 0;
+      if (instr->is_call() && instr->get_operand(instr->num_ops_ - 1) == foo &&
+          static_cast<CallInst *>(instr)->isTailCall())
+        calls.push_back(static_cast<CallInst *>(instr));
+    }
+  if (calls.empty())
+    return 0;
+
+  // 新的入口块只跳转到原入口块，原入口块成为循环头
+  auto header = foo->basic_blocks_.front();
+  auto entry = new BasicBlock(m, "label_entry", foo);
+  header->name_ = "";
+  foo->basic_blocks_.pop_back();
+  foo->basic_blocks_.insert(foo->basic_blocks_.begin(), entry);
+  new BranchInst(header, entry);
+
+  std::vector<PhiInst *> phis;
+  for (auto arg : foo->arguments_) {
+    if (arg->use_list_.empty()) {
+      phis.push_back(nullptr);
+      continue;
+    }
+    auto phi = PhiInst::create_phi(arg->type_, header);
+    header->add_instruction_front(phi);
+    arg->replace_all_use_with(phi);
+    phi->add_phi_pair_operand(arg, entry);
+    phis.push_back(phi);
+  }
+
+  for (auto call : calls) {
+    auto bb = call->parent_;
+    auto term = bb->get_terminator();
+    // 跳转到返回块时，先撤去返回块 phi 中本块的入值
+    if (term->is_br()) {
+      auto succ = static_cast<BasicBlock *>(term->get_operand(0));
+      bb->remove_succ_basic_block(succ);
+      succ->remove_pre_basic_block(bb);
+      bb->delete_instr(term);
+      SolvePhi(bb, succ);
+    } else
+      bb->delete_instr(term);
+    for (int i = 0; i < phis.size(); i++)
+      if (phis[i])
+        phis[i]->add_phi_pair_operand(call->get_operand(i), bb);
+    bb->delete_instr(call);
+    new BranchInst(header, bb);
+  }
+  // 全部返回都来自尾调用时返回块不再可达
+  DeleteUnusedBB(foo);
+  return calls.size();
+}
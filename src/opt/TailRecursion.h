@@ -0,0 +1,16 @@
+#ifndef TAILRECURSIONH
+#define TAILRECURSIONH
+
+#include "BasicOperation.h"
+
+// 尾递归消除：将自身的尾调用改写为跳回函数开头的循环。
+// 新建入口块跳转到原入口块，原入口块中以 phi 合流形参与各尾调用的实参。
+class TailRecursionElim : public FunctionPass {
+public:
+  TailRecursionElim(Module *m) : FunctionPass(m) {}
+  void runOnFunction(Function *foo);
+  // 返回消除的尾调用数
+  int eliminate(Function *foo);
+};
+
+#endif // !TAILRECURSIONH
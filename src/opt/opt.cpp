@@ -1,13 +1,84 @@
 #include "opt.h"
+#include "AliasAnalysis.h"
+#include "LoopInfo.h"
 #include <functional>
 #include <vector>
 
+void AnalysisManager::require(Function *foo, int ids) {
+  if (foo->basic_blocks_.empty())
+    return;
+  if (ids & LOOP_INFO)
+    ids |= DOMINATOR;
+  int missing = ids & ~valid[foo];
+  if (missing & DOMINATOR)
+    DomainTree(m).runOnFunction(foo);
+  if (missing & POST_DOMINATOR)
+    ReverseDomainTree(m).runOnFunction(foo);
+  if (missing & LOOP_INFO)
+    LoopInfo(m).runOnFunction(foo);
+  valid[foo] |= missing;
+}
+
+// 循环由支配树导出，支配树失效时一并失效
+void AnalysisManager::invalidate(Function *foo, int ids) {
+  if (ids & DOMINATOR)
+    ids |= LOOP_INFO;
+  valid[foo] &= ~ids;
+}
+
+void AnalysisManager::invalidateExcept(int preserved) {
+  if (!(preserved & DOMINATOR))
+    preserved &= ~LOOP_INFO;
+  for (auto &[foo, ids] : valid)
+    ids &= preserved;
+}
+
+void Optimization::requireAnalysis(Function *foo, int ids) {
+  if (am != nullptr) {
+    am->require(foo, ids);
+    return;
+  }
+  if (foo->basic_blocks_.empty())
+    return;
+  if (ids & (DOMINATOR | LOOP_INFO))
+    DomainTree(m).runOnFunction(foo);
+  if (ids & POST_DOMINATOR)
+    ReverseDomainTree(m).runOnFunction(foo);
+  if (ids & LOOP_INFO)
+    LoopInfo(m).runOnFunction(foo);
+}
+
+void Optimization::invalidateAnalysis(Function *foo, int ids) {
+  if (am != nullptr)
+    am->invalidate(foo, ids);
+}
+
+void FunctionPass::execute() {
+  int modules = requiredModule();
+  if (modules & (FUNC_INFO | ALIAS_ANALYSIS))
+    info = new FuncInfo(m);
+  if (modules & ALIAS_ANALYSIS)
+    aa = new AliasAnalysis(m, info);
+  for (auto foo : m->function_list_)
+    if (!foo->basic_blocks_.empty())
+      runOnFunction(foo);
+  delete aa;
+  delete info;
+  aa = nullptr;
+  info = nullptr;
+}
+
 void DomainTree::execute() {
   for (auto foo : m->function_list_)
-    if (!foo->basic_blocks_.empty()) {
-      getBlockDom(foo);
-      getBlockDomFront(foo);
-    }
+    if (!foo->basic_blocks_.empty())
+      runOnFunction(foo);
+}
+
+void DomainTree::runOnFunction(Function *foo) {
+  for (auto bb : foo->basic_blocks_)
+    bb->dom_frontier_.clear();
+  getBlockDom(foo);
+  getBlockDomFront(foo);
 }
 
 bool DomainTree::isLoopEdge(BasicBlock *a, BasicBlock *b) {
@@ -100,15 +171,18 @@ BasicBlock *DomainTree::intersect(BasicBlock *b1, BasicBlock *b2) {
 
 void ReverseDomainTree::execute() {
   for (auto f : m->function_list_)
-    if (!f->basic_blocks_.empty()) {
-      for (auto bb : f->basic_blocks_) {
-        bb->rdoms_.clear();
-        bb->rdom_frontier_.clear();
-      }
-      getBlockDomR(f);
-      getBlockDomFrontR(f);
-      getBlockRdoms(f);
-    }
+    if (!f->basic_blocks_.empty())
+      runOnFunction(f);
+}
+
+void ReverseDomainTree::runOnFunction(Function *f) {
+  for (auto bb : f->basic_blocks_) {
+    bb->rdoms_.clear();
+    bb->rdom_frontier_.clear();
+  }
+  getBlockDomR(f);
+  getBlockDomFrontR(f);
+  getBlockRdoms(f);
 }
 
 void ReverseDomainTree::getPostTraverse(BasicBlock *bb,
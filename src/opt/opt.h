@@ -4,11 +4,70 @@
 
 #include "ir.h"
 
+// 可被缓存的函数级分析，按位组合
+enum AnalysisID {
+  DOMINATOR = 1,      // idom_ 与 dom_frontier_
+  POST_DOMINATOR = 2, // rdoms_ 与 rdom_frontier_
+  LOOP_INFO = 4,      // loops_、loop_ 与 loop_depth_，依赖 DOMINATOR
+  ALL_ANALYSIS = DOMINATOR | POST_DOMINATOR | LOOP_INFO
+};
+
+// 过程间分析，运行前由 FunctionPass::execute 或 PassManager 统一计算
+enum ModuleAnalysisID {
+  FUNC_INFO = 1,      // 函数的副作用摘要
+  ALIAS_ANALYSIS = 2, // 别名分析，依赖 FUNC_INFO
+};
+
+class FuncInfo;
+class AliasAnalysis;
+
+// 记录每个函数上哪些分析结果仍然有效，失效的分析在下次被请求时才重新计算。
+// 各函数的记录在构造时全部建立，不同函数的分析可以在多个线程中同时进行。
+class AnalysisManager {
+  std::map<Function *, int> valid;
+
+public:
+  Module *m;
+  explicit AnalysisManager(Module *m_) : m(m_) {
+    for (auto foo : m->function_list_)
+      valid[foo] = 0;
+  }
+  void require(Function *foo, int ids);
+  void invalidate(Function *foo, int ids = ALL_ANALYSIS);
+  // 保留所有函数上的 preserved 分析，其余标记为失效
+  void invalidateExcept(int preserved);
+};
+
 class Optimization {
 public:
   Module *m;
+  // 由 PassManager 设置；为空时每次请求分析都重新计算
+  AnalysisManager *am = nullptr;
   explicit Optimization(Module *m_) : m(m_) {}
+  virtual ~Optimization() = default;
   virtual void execute() = 0;
+  // 运行前需要在每个函数上有效的分析
+  virtual int required() { return 0; }
+  // 运行后仍然有效的分析（即不改变控制流图的 pass 返回 ALL_ANALYSIS）
+  virtual int preserved() { return 0; }
+  // 在 pass 内部改变控制流图后，通过下面两个函数使分析失效并重新获取
+  void requireAnalysis(Function *foo, int ids);
+  void invalidateAnalysis(Function *foo, int ids = ALL_ANALYSIS);
+};
+
+// 逐个函数独立运行的 pass：只修改当前函数，成员变量只保存当前函数的状态，
+// 读取其他函数时只通过运行前计算好的过程间分析。
+// -j 模式下每个函数使用单独的 pass 对象，在工作线程中并行运行。
+class FunctionPass : public Optimization {
+public:
+  FuncInfo *info = nullptr;
+  AliasAnalysis *aa = nullptr;
+  explicit FunctionPass(Module *m_) : Optimization(m_) {}
+  // 计算所需的过程间分析，依次在每个有函数体的函数上运行
+  void execute();
+  virtual void runOnFunction(Function *foo) = 0;
+  // 运行前需要的过程间分析，运行期间只读
+  virtual int requiredModule() { return 0; }
 };
 
 class DomainTree : public Optimization {
@@ -19,6 +78,7 @@ class DomainTree : public Optimization {
 public:
   DomainTree(Module *m) : Optimization(m) {}
   void execute();
+  void runOnFunction(Function *foo);
   void getReversePostTraverse(Function *foo);
   std::vector<BasicBlock *> postTraverse(BasicBlock *bb);
   void getBlockDom(Function *foo);
@@ -36,6 +96,7 @@ class ReverseDomainTree : public Optimization {
 public:
   ReverseDomainTree(Module *m) : Optimization(m), exitBlock(nullptr) {}
   void execute();
+  void runOnFunction(Function *foo);
   BasicBlock *intersect(BasicBlock *b1, BasicBlock *b2);
   void getReversePostTraverse(Function *foo);
   void getBlockDomR(Function *foo);
@@ -1,4 +1,5 @@
 #include "backend.h"
+#include "utils.h"
 #include <cassert>
 
 void RiscvBuilder::initializeRegisterFile() {
@@ -34,26 +35,25 @@ const std::map<Instruction::OpID, RiscvInstr::InstrType> toRiscvOp = {
     {Instruction::OpID::Store, RiscvInstr::InstrType::SW},
 };
 
-int LabelCount = 0;
-std::map<BasicBlock *, RiscvBasicBlock *> rbbLabel;
 std::map<Function *, RiscvFunction *> functionLabel;
 std::string toLabel(int ind) { return ".L" + std::to_string(ind); }
 
-RiscvBasicBlock *createRiscvBasicBlock(BasicBlock *bb) {
-  if (bb == nullptr) {
-    LabelCount++;
-    return new RiscvBasicBlock(toLabel(LabelCount), LabelCount);
-  }
-  if (rbbLabel.count(bb))
+RiscvBasicBlock *RiscvBuilder::createRiscvBasicBlock(BasicBlock *bb) {
+  if (bb != nullptr && rbbLabel.count(bb))
     return rbbLabel[bb];
-  LabelCount++;
-  auto cur = new RiscvBasicBlock(toLabel(LabelCount), LabelCount);
-  return rbbLabel[bb] = cur;
+  // 标号在全部函数生成完毕后统一确定
+  int ind = labels.size() + 1;
+  auto cur = new RiscvBasicBlock(toLabel(ind), ind);
+  labels.push_back(cur);
+  if (bb != nullptr)
+    rbbLabel[bb] = cur;
+  return cur;
 }
 
 RiscvFunction *createRiscvFunction(Function *foo) {
   assert(foo != nullptr);
-  if (functionLabel.count(foo) == 0) {
+  auto iter = functionLabel.find(foo);
+  if (iter == functionLabel.end()) {
     auto ty = RiscvOperand::Void;
     switch (foo->type_->tid_) {
     case Type::VoidTyID:
@@ -70,7 +70,7 @@ RiscvFunction *createRiscvFunction(Function *foo) {
         new RiscvFunction(foo->name_, foo->arguments_.size(), ty);
     return functionLabel[foo] = cur;
   }
-  return functionLabel[foo];
+  return iter->second;
 }
 
 BinaryRiscvInst *RiscvBuilder::createBinaryInstr(RegAlloca *regAlloca,
@@ -104,6 +104,24 @@ BinaryRiscvInst *RiscvBuilder::createBinaryInstr(RegAlloca *regAlloca,
     case Instruction::OpID::SRem:
       value_result = value[0] % value[1];
       break;
+    case Instruction::OpID::And:
+      value_result = value[0] & value[1];
+      break;
+    case Instruction::OpID::Or:
+      value_result = value[0] | value[1];
+      break;
+    case Instruction::OpID::Xor:
+      value_result = value[0] ^ value[1];
+      break;
+    case Instruction::OpID::Shl:
+      value_result = (unsigned)value[0] << (value[1] & 31);
+      break;
+    case Instruction::OpID::AShr:
+      value_result = value[0] >> (value[1] & 31);
+      break;
+    case Instruction::OpID::LShr:
+      value_result = (unsigned)value[0] >> (value[1] & 31);
+      break;
     default:
       std::cerr << "[Fatal Error] Binary instruction immediate caculation not "
                    "implemented."
@@ -115,6 +133,42 @@ BinaryRiscvInst *RiscvBuilder::createBinaryInstr(RegAlloca *regAlloca,
                           value_result, rbb));
     return nullptr;
   }
+  // 第二个操作数为 12 位常量时选择立即数形式，可交换的运算先交换操作数；
+  // 减去常量改为加上其相反数
+  static const std::map<Instruction::OpID, RiscvInstr::InstrType> immOp = {
+      {Instruction::OpID::Add, RiscvInstr::ADDI},
+      {Instruction::OpID::Sub, RiscvInstr::ADDI},
+      {Instruction::OpID::And, RiscvInstr::ANDI},
+      {Instruction::OpID::Or, RiscvInstr::ORI},
+      {Instruction::OpID::Xor, RiscvInstr::XORI},
+      {Instruction::OpID::Shl, RiscvInstr::SHLI},
+      {Instruction::OpID::AShr, RiscvInstr::ASHRI},
+      {Instruction::OpID::LShr, RiscvInstr::LSHRI}};
+  auto opid = binaryInstr->op_id_;
+  if (immOp.count(opid)) {
+    Value *lhs = binaryInstr->operands_[0], *rhs = binaryInstr->operands_[1];
+    if (dynamic_cast<ConstantInt *>(lhs) != nullptr &&
+        opid != Instruction::OpID::Sub && immOp.at(opid) != RiscvInstr::SHLI &&
+        immOp.at(opid) != RiscvInstr::ASHRI &&
+        immOp.at(opid) != RiscvInstr::LSHRI)
+      std::swap(lhs, rhs);
+    auto cval = dynamic_cast<ConstantInt *>(rhs);
+    if (cval != nullptr) {
+      long long imm = cval->value_;
+      if (opid == Instruction::OpID::Sub)
+        imm = -imm;
+      bool shift = opid == Instruction::OpID::Shl ||
+                   opid == Instruction::OpID::AShr ||
+                   opid == Instruction::OpID::LShr;
+      if (shift ? imm >= 0 && imm < 32 : isImm12(imm))
+        return new BinaryRiscvInst(
+            immOp.at(opid), regAlloca->findReg(lhs, rbb, nullptr, 1),
+            new RiscvConst(static_cast<int>(imm)),
+            regAlloca->findReg(binaryInstr, rbb, nullptr, 1, 0), rbb, true);
+    }
+  }
+  if (solveConstMulDiv(regAlloca, binaryInstr, rbb))
+    return nullptr;
   BinaryRiscvInst *instr = new BinaryRiscvInst(
       id, regAlloca->findReg(binaryInstr->operands_[0], rbb, nullptr, 1),
       regAlloca->findReg(binaryInstr->operands_[1], rbb, nullptr, 1),
@@ -122,6 +176,151 @@ BinaryRiscvInst *RiscvBuilder::createBinaryInstr(RegAlloca *regAlloca,
   return instr;
 }
 
+// 有符号 32 位除以常量 d（2 <= d < 2^31，非 2 的幂）的魔数 M 与移位量 s ，
+// 见 Hacker's Delight 10-1 。n / d = ((mulh(n, M) [+ n，M < 0 时]) >> s) + (n < 0)
+static void magicNumber(unsigned d, int &M, int &s) {
+  const unsigned two31 = 0x80000000u;
+  unsigned anc = two31 - 1 - two31 % d;
+  unsigned q1 = two31 / anc, r1 = two31 - q1 * anc;
+  unsigned q2 = two31 / d, r2 = two31 - q2 * d;
+  unsigned delta;
+  int p = 31;
+  do {
+    p++;
+    q1 *= 2, r1 *= 2;
+    if (r1 >= anc)
+      q1++, r1 -= anc;
+    q2 *= 2, r2 *= 2;
+    if (r2 >= d)
+      q2++, r2 -= d;
+    delta = d - r2;
+  } while (q1 < delta || (q1 == delta && r1 == 0));
+  M = static_cast<int>(q2 + 1u);
+  s = p - 32;
+}
+
+// 临时寄存器 t3、t4 用于保存中间结果
+bool RiscvBuilder::solveConstMulDiv(RegAlloca *regAlloca,
+                                    BinaryInst *binaryInstr,
+                                    RiscvBasicBlock *rbb) {
+  auto opid = binaryInstr->op_id_;
+  Value *lhs = binaryInstr->operands_[0], *rhs = binaryInstr->operands_[1];
+  if (opid == Instruction::OpID::Mul &&
+      dynamic_cast<ConstantInt *>(lhs) != nullptr)
+    std::swap(lhs, rhs);
+  auto cval = dynamic_cast<ConstantInt *>(rhs);
+  if (cval == nullptr || (opid != Instruction::OpID::Mul &&
+                          opid != Instruction::OpID::SDiv &&
+                          opid != Instruction::OpID::SRem))
+    return false;
+  long long c = cval->value_, absC = std::llabs(c);
+  auto t3 = getRegOperand("t3"), t4 = getRegOperand("t4");
+  auto zero = getRegOperand("zero");
+  auto log2 = [](long long x) {
+    int k = 0;
+    while ((1ll << k) < x)
+      k++;
+    return (1ll << k) == x ? k : -1;
+  };
+  auto emit = [&](RiscvInstr::InstrType op, RiscvOperand *v1, RiscvOperand *v2,
+                  RiscvOperand *target, bool word = true) {
+    rbb->addInstrBack(new BinaryRiscvInst(op, v1, v2, target, rbb, word));
+  };
+  auto imm = [](long long val) { return new RiscvConst(static_cast<int>(val)); };
+
+  if (opid == Instruction::OpID::Mul) {
+    // 乘以 2^k、2^k±1 或 2^a+2^b 时使用移位与加减，否则仍使用乘法
+    int k = log2(absC), a = -1, b = -1;
+    int op = 0; // 0: 移位，1: 2^a+1，-1: 2^a-1，2: 2^a+2^b
+    if (absC > 1 && k < 0) {
+      if (log2(absC - 1) > 0)
+        op = 1, a = log2(absC - 1);
+      else if (log2(absC + 1) > 0)
+        op = -1, a = log2(absC + 1);
+      else {
+        long long low = absC & -absC;
+        if (log2(absC - low) > 0)
+          op = 2, a = log2(absC - low), b = log2(low);
+        else
+          return false;
+      }
+    }
+    auto src = regAlloca->findReg(lhs, rbb, nullptr, 1);
+    auto dest = regAlloca->findReg(binaryInstr, rbb, nullptr, 1, 0);
+    if (c == 0)
+      rbb->addInstrBack(new MoveRiscvInst(dest, 0, rbb));
+    else if (absC == 1)
+      rbb->addInstrBack(new MoveRiscvInst(dest, src, rbb));
+    else if (op == 0)
+      emit(RiscvInstr::SHLI, src, imm(k), dest);
+    else if (op == 2) {
+      emit(RiscvInstr::SHLI, src, imm(a), t3);
+      emit(RiscvInstr::SHLI, src, imm(b), t4);
+      emit(RiscvInstr::ADD, t3, t4, dest);
+    } else {
+      emit(RiscvInstr::SHLI, src, imm(a), t3);
+      emit(op == 1 ? RiscvInstr::ADD : RiscvInstr::SUB, t3, src, dest);
+    }
+    if (c < 0)
+      emit(RiscvInstr::SUB, zero, dest, dest);
+    return true;
+  }
+
+  // 除数为 0 或 -2^31 时保留除法指令
+  if (c == 0 || absC > INT32_MAX)
+    return false;
+  auto src = regAlloca->findReg(lhs, rbb, nullptr, 1);
+  auto dest = regAlloca->findReg(binaryInstr, rbb, nullptr, 1, 0);
+  if (absC == 1) {
+    if (opid == Instruction::OpID::SRem)
+      rbb->addInstrBack(new MoveRiscvInst(dest, 0, rbb));
+    else if (c == 1)
+      rbb->addInstrBack(new MoveRiscvInst(dest, src, rbb));
+    else
+      emit(RiscvInstr::SUB, zero, src, dest);
+    return true;
+  }
+  // 商 |n / |c|| 向零取整，写入 t3
+  int k = log2(absC);
+  if (k > 0) {
+    // 负数需加上 2^k - 1 的偏置
+    emit(RiscvInstr::ASHRI, src, imm(31), t3);
+    emit(RiscvInstr::LSHRI, t3, imm(32 - k), t3);
+    emit(RiscvInstr::ADD, src, t3, t3);
+    emit(RiscvInstr::ASHRI, t3, imm(k), t3);
+  } else {
+    // M >= 2^31 时按有符号数载入，乘积的高 32 位需再加上 n
+    int M, s;
+    magicNumber(absC, M, s);
+    rbb->addInstrBack(new MoveRiscvInst(t3, M, rbb));
+    emit(RiscvInstr::MUL, src, t3, t3, false);
+    if (M < 0) {
+      emit(RiscvInstr::ASHRI, t3, imm(32), t3, false);
+      emit(RiscvInstr::ADD, t3, src, t3, false);
+      emit(RiscvInstr::ASHRI, t3, imm(s), t3, false);
+    } else
+      emit(RiscvInstr::ASHRI, t3, imm(32 + s), t3, false);
+    emit(RiscvInstr::LSHRI, src, imm(63), t4, false);
+    emit(RiscvInstr::ADD, t3, t4, t3);
+  }
+  if (opid == Instruction::OpID::SDiv) {
+    if (c < 0)
+      emit(RiscvInstr::SUB, zero, t3, dest);
+    else
+      rbb->addInstrBack(new MoveRiscvInst(dest, t3, rbb));
+    return true;
+  }
+  // 余数 n - (n / |c|) * |c| ，其符号与 n 相同
+  if (k > 0)
+    emit(RiscvInstr::SHLI, t3, imm(k), t3);
+  else {
+    rbb->addInstrBack(new MoveRiscvInst(t4, static_cast<int>(absC), rbb));
+    emit(RiscvInstr::MUL, t3, t4, t3);
+  }
+  emit(RiscvInstr::SUB, src, t3, dest);
+  return true;
+}
+
 UnaryRiscvInst *RiscvBuilder::createUnaryInstr(RegAlloca *regAlloca,
                                                UnaryInst *unaryInstr,
                                                RiscvBasicBlock *rbb) {
@@ -211,21 +410,57 @@ std::vector<RiscvInstr *> RiscvBuilder::createLoadInstr(RegAlloca *regAlloca,
 
 ICmpRiscvInstr *RiscvBuilder::createICMPInstr(RegAlloca *regAlloca,
                                               ICmpInst *icmpInstr,
-                                              BranchInst *brInstr,
+                                              RiscvBasicBlock *trueLink,
+                                              RiscvBasicBlock *falseLink,
                                               RiscvBasicBlock *rbb) {
+  // 与 0 比较时直接使用 zero 寄存器
+  auto getOperand = [&](Value *val) {
+    auto cval = dynamic_cast<ConstantInt *>(val);
+    if (cval != nullptr && cval->value_ == 0)
+      return getRegOperand("zero");
+    return regAlloca->findReg(val, rbb, nullptr, 1);
+  };
   ICmpRiscvInstr *instr = new ICmpRiscvInstr(
-      icmpInstr->icmp_op_,
-      regAlloca->findReg(icmpInstr->operands_[0], rbb, nullptr, 1),
-      regAlloca->findReg(icmpInstr->operands_[1], rbb, nullptr, 1),
-      createRiscvBasicBlock(static_cast<BasicBlock *>(brInstr->operands_[1])),
-      createRiscvBasicBlock(static_cast<BasicBlock *>(brInstr->operands_[2])),
-      rbb);
+      icmpInstr->icmp_op_, getOperand(icmpInstr->operands_[0]),
+      getOperand(icmpInstr->operands_[1]), trueLink, falseLink, rbb);
   return instr;
 }
 
 ICmpRiscvInstr *RiscvBuilder::createICMPSInstr(RegAlloca *regAlloca,
                                                ICmpInst *icmpInstr,
                                                RiscvBasicBlock *rbb) {
+  // 与 12 位常量比较时使用 SLTI/SLTIU：x <= c 即 x < c + 1，x > c 即 x >= c + 1
+  if (auto cval = dynamic_cast<ConstantInt *>(icmpInstr->operands_[1])) {
+    auto op = icmpInstr->icmp_op_;
+    long long imm = cval->value_;
+    static const std::map<ICmpInst::ICmpOp, ICmpInst::ICmpOp> plusOne = {
+        {ICmpInst::ICMP_SLE, ICmpInst::ICMP_SLT},
+        {ICmpInst::ICMP_SGT, ICmpInst::ICMP_SGE},
+        {ICmpInst::ICMP_ULE, ICmpInst::ICMP_ULT},
+        {ICmpInst::ICMP_UGT, ICmpInst::ICMP_UGE}};
+    auto iter = plusOne.find(op);
+    if (iter != plusOne.end()) {
+      // c 为最大值时 c + 1 溢出，不进行变换
+      bool isSigned = op == ICmpInst::ICMP_SLE || op == ICmpInst::ICMP_SGT;
+      if (isSigned ? imm == INT32_MAX : imm == -1)
+        imm = INT64_MAX;
+      else {
+        op = iter->second;
+        imm++;
+      }
+    }
+    if (isImm12(imm)) {
+      auto dest = regAlloca->findReg(icmpInstr, rbb, nullptr, 1, 0);
+      ICmpSRiscvInstr *instr = new ICmpSRiscvInstr(
+          op, regAlloca->findReg(icmpInstr->operands_[0], rbb, nullptr, 1),
+          new RiscvConst(static_cast<int>(imm)), dest, rbb);
+      rbb->addInstrBack(instr);
+      if (op == ICmpInst::ICMP_SGE || op == ICmpInst::ICMP_UGE)
+        rbb->addInstrBack(new BinaryRiscvInst(RiscvInstr::XORI, dest,
+                                              new RiscvConst(1), dest, rbb));
+      return instr;
+    }
+  }
   bool swap = ICmpSRiscvInstr::ICmpOpSName.count(icmpInstr->icmp_op_) == 0;
   if (swap) {
     std::swap(icmpInstr->operands_[0], icmpInstr->operands_[1]);
@@ -258,13 +493,15 @@ ICmpRiscvInstr *RiscvBuilder::createICMPSInstr(RegAlloca *regAlloca,
 
 RiscvInstr *RiscvBuilder::createFCMPInstr(RegAlloca *regAlloca,
                                           FCmpInst *fcmpInstr,
-                                          RiscvBasicBlock *rbb) {
+                                          RiscvBasicBlock *rbb,
+                                          RiscvOperand *dest) {
+  if (dest == nullptr)
+    dest = regAlloca->findReg(fcmpInstr, rbb, nullptr, 1, 0);
   // Deal with always true
   if (fcmpInstr->fcmp_op_ == fcmpInstr->FCMP_TRUE ||
       fcmpInstr->fcmp_op_ == fcmpInstr->FCMP_FALSE) {
     auto instr =
-        new MoveRiscvInst(regAlloca->findReg(fcmpInstr, rbb, nullptr, 1, 0),
-                          fcmpInstr->fcmp_op_ == fcmpInstr->FCMP_TRUE, rbb);
+        new MoveRiscvInst(dest, fcmpInstr->fcmp_op_ == fcmpInstr->FCMP_TRUE, rbb);
     rbb->addInstrBack(instr);
     return instr;
   }
@@ -302,13 +539,11 @@ RiscvInstr *RiscvBuilder::createFCMPInstr(RegAlloca *regAlloca,
   FCmpRiscvInstr *instr = new FCmpRiscvInstr(
       fcmpInstr->fcmp_op_,
       regAlloca->findReg(fcmpInstr->operands_[0], rbb, nullptr, 1),
-      regAlloca->findReg(fcmpInstr->operands_[1], rbb, nullptr, 1),
-      regAlloca->findReg(fcmpInstr, rbb, nullptr, 1, 0), rbb);
+      regAlloca->findReg(fcmpInstr->operands_[1], rbb, nullptr, 1), dest, rbb);
   rbb->addInstrBack(instr);
   if (inv) {
-    auto instr_reg = regAlloca->findReg(fcmpInstr, rbb, nullptr, 1, 0);
-    rbb->addInstrBack(new BinaryRiscvInst(RiscvInstr::XORI, instr_reg,
-                                          new RiscvConst(1), instr_reg, rbb));
+    rbb->addInstrBack(new BinaryRiscvInst(RiscvInstr::XORI, dest,
+                                          new RiscvConst(1), dest, rbb));
     return instr;
   }
   return instr;
@@ -332,41 +567,60 @@ ReturnRiscvInst *RiscvBuilder::createRetInstr(RegAlloca *regAlloca,
                                               ReturnInst *returnInstr,
                                               RiscvBasicBlock *rbb,
                                               RiscvFunction *rfoo) {
-  RiscvOperand *reg_to_save = nullptr;
-
   // If ret i32 %4
   if (returnInstr->num_ops_ > 0) {
     // 写返回值到 a0/fa0 中
     auto operand = returnInstr->operands_[0];
-    if (operand->type_->tid_ == Type::TypeID::IntegerTyID)
-      reg_to_save = regAlloca->findSpecificReg(operand, "a0", rbb);
-    else if (operand->type_->tid_ == Type::TypeID::FloatTyID)
-      reg_to_save = regAlloca->findSpecificReg(operand, "fa0", rbb);
-    // auto instr = regAlloca->writeback(reg_to_save, rbb);
-
-    rbb->addInstrBack(new MoveRiscvInst(
-        reg_to_save, regAlloca->findReg(operand, rbb, nullptr), rbb));
+    if (operand->type_->tid_ == Type::TypeID::FloatTyID)
+      regAlloca->loadValue(operand, getRegOperand("fa0"), rbb);
+    else
+      regAlloca->loadValue(operand, getRegOperand("a0"), rbb);
   }
 
   return new ReturnRiscvInst(rbb);
 }
 
-BranchRiscvInstr *RiscvBuilder::createBrInstr(RegAlloca *regAlloca,
-                                              BranchInst *brInstr,
-                                              RiscvBasicBlock *rbb) {
+RiscvInstr *RiscvBuilder::createBrInstr(RegAlloca *regAlloca,
+                                        BranchInst *brInstr,
+                                        RiscvBasicBlock *rbb,
+                                        Instruction *cmpInstr) {
 
-  BranchRiscvInstr *instr;
+  auto bb = brInstr->parent_;
+  RiscvInstr *instr;
   if (brInstr->num_ops_ == 1) {
-    instr = new BranchRiscvInstr(
-        nullptr, nullptr,
-        createRiscvBasicBlock(static_cast<BasicBlock *>(brInstr->operands_[0])),
-        rbb);
+    auto succ = static_cast<BasicBlock *>(brInstr->operands_[0]);
+    this->solvePhiCopy(regAlloca, bb, succ, rbb);
+    instr = new BranchRiscvInstr(nullptr, nullptr, createRiscvBasicBlock(succ),
+                                 rbb);
   } else {
-    instr = new BranchRiscvInstr(
-        regAlloca->findReg(brInstr->operands_[0], rbb, nullptr, 1),
-        createRiscvBasicBlock(static_cast<BasicBlock *>(brInstr->operands_[1])),
-        createRiscvBasicBlock(static_cast<BasicBlock *>(brInstr->operands_[2])),
-        rbb);
+    // 浮点比较的结果写入临时寄存器 t0 后跳转；整型比较在跳转时进行
+    RiscvOperand *cond = nullptr;
+    if (cmpInstr == nullptr)
+      cond = regAlloca->findReg(brInstr->operands_[0], rbb, nullptr, 1);
+    else if (cmpInstr->is_fcmp()) {
+      cond = getRegOperand("t0");
+      createFCMPInstr(regAlloca, static_cast<FCmpInst *>(cmpInstr), rbb, cond);
+    }
+    RiscvBasicBlock *target[2];
+    for (int i = 0; i < 2; i++) {
+      auto succ = static_cast<BasicBlock *>(brInstr->operands_[i + 1]);
+      target[i] = createRiscvBasicBlock(succ);
+      auto copies = this->getPhiCopy(regAlloca, bb, succ);
+      if (copies.empty())
+        continue;
+      // 关键边：在新的基本块中完成 phi 的复制后再跳转
+      auto edge = createRiscvBasicBlock();
+      regAlloca->parallelCopy(copies, edge);
+      edge->addInstrBack(
+          new BranchRiscvInstr(nullptr, nullptr, target[i], edge));
+      edgeBlocks.push_back(edge);
+      target[i] = edge;
+    }
+    if (cmpInstr != nullptr && cmpInstr->is_cmp())
+      instr = createICMPInstr(regAlloca, static_cast<ICmpInst *>(cmpInstr),
+                              target[0], target[1], rbb);
+    else
+      instr = new BranchRiscvInstr(cond, target[0], target[1], rbb);
   }
   return instr;
 }
@@ -389,30 +643,28 @@ FpToSiRiscvInstr *RiscvBuilder::createFptoSiInstr(RegAlloca *regAlloca,
       rbb);
 }
 
-// 固定采用x30作为偏移量，x31作为乘法的LI指令地址
+// 下标与元素大小的乘积使用 t3 作为临时寄存器
 RiscvInstr *RiscvBuilder::solveGetElementPtr(RegAlloca *regAlloca,
                                              GetElementPtrInst *instr,
                                              RiscvBasicBlock *rbb) {
-  Value *op0 = instr->get_operand(0);
-  RiscvOperand *dest = getRegOperand("t2");
-  bool isConst = 1; // 能否用确定的形如 -12(sp)访问
-  int finalOffset = 0;
+  Value *op0 = regAlloca->DSU_for_Variable.query(instr->get_operand(0));
+  RiscvOperand *dest = regAlloca->findReg(instr, rbb, nullptr, 1, 0);
+  RiscvOperand *base = nullptr;
+  int totalOffset = 0;
   if (dynamic_cast<GlobalVariable *>(op0) != nullptr) {
     // 全局变量：使用la指令取基础地址
-    isConst = 0;
     rbb->addInstrBack(new LoadAddressRiscvInstr(dest, op0->name_, rbb));
-  } else if (auto oi = dynamic_cast<Instruction *>(op0)) {
-    // 获取指针指向的地址
-    int varOffset = 0;
-
-    rbb->addInstrBack(new MoveRiscvInst(
-        dest, regAlloca->findReg(op0, rbb, nullptr, 1, 1), rbb));
-
-    finalOffset += varOffset;
+    base = dest;
+  } else if (dynamic_cast<AllocaInst *>(op0) != nullptr) {
+    // 栈上数组：基础地址为 fp 加常量偏移
+    base = getRegOperand("fp");
+    totalOffset = static_cast<RiscvIntPhiReg *>(regAlloca->findMem(op0))->shift_;
+  } else {
+    // 获取指针指向的地址（指令结果或提升后的形参指针）
+    base = regAlloca->findReg(op0, rbb, nullptr, 1);
   }
   int curTypeSize = 0;
   unsigned int num_operands = instr->num_ops_;
-  int indexVal, totalOffset = 0;
   Type *cur_type =
       static_cast<PointerType *>(instr->get_operand(0)->type_)->contained_;
   for (unsigned int i = 1; i <= num_operands - 1; i++) {
@@ -421,30 +673,50 @@ RiscvInstr *RiscvBuilder::solveGetElementPtr(RegAlloca *regAlloca,
     Value *opi = instr->get_operand(i);
     curTypeSize = calcTypeSize(cur_type);
     if (auto ci = dynamic_cast<ConstantInt *>(opi)) {
-      indexVal = ci->value_;
-      totalOffset += indexVal * curTypeSize;
+      totalOffset += ci->value_ * curTypeSize;
     } else {
       // 存在变量参与偏移量计算
-      isConst = 0;
-      // 考虑目标数是int还是float
       RiscvOperand *mulTempReg = getRegOperand("t3");
       rbb->addInstrBack(new MoveRiscvInst(mulTempReg, curTypeSize, rbb));
       rbb->addInstrBack(new BinaryRiscvInst(
           RiscvInstr::InstrType::MUL, regAlloca->findReg(opi, rbb, nullptr, 1),
           mulTempReg, mulTempReg, rbb));
       rbb->addInstrBack(new BinaryRiscvInst(RiscvInstr::InstrType::ADD,
-                                            mulTempReg, dest, dest, rbb));
+                                            mulTempReg, base, dest, rbb));
+      base = dest;
     }
   }
-  // if (totalOffset > 0)
-  rbb->addInstrBack(new BinaryRiscvInst(RiscvInstr::InstrType::ADDI, dest,
-                                        new RiscvConst(totalOffset), dest,
-                                        rbb));
-  rbb->addInstrBack(
-      new StoreRiscvInst(instr->type_, dest, regAlloca->findMem(instr), rbb));
+  if (base != dest || totalOffset != 0)
+    rbb->addInstrBack(new BinaryRiscvInst(RiscvInstr::InstrType::ADDI, base,
+                                          new RiscvConst(totalOffset), dest,
+                                          rbb));
   return nullptr;
 }
 
+std::vector<CopyPair> RiscvBuilder::getPhiCopy(RegAlloca *regAlloca,
+                                               BasicBlock *bb,
+                                               BasicBlock *succ) {
+  std::vector<CopyPair> copies;
+  for (auto instr : succ->instr_list_) {
+    if (instr->op_id_ != Instruction::OpID::PHI)
+      break;
+    auto dest = regAlloca->getLocation(instr);
+    for (int i = 1; i < instr->num_ops_; i += 2)
+      if (instr->get_operand(i) == bb) {
+        auto val = instr->get_operand(i - 1);
+        if (dest != regAlloca->getLocation(val))
+          copies.push_back({dest, val, nullptr});
+        break;
+      }
+  }
+  return copies;
+}
+
+void RiscvBuilder::solvePhiCopy(RegAlloca *regAlloca, BasicBlock *bb,
+                                BasicBlock *succ, RiscvBasicBlock *rbb) {
+  regAlloca->parallelCopy(getPhiCopy(regAlloca, bb, succ), rbb);
+}
+
 void RiscvBuilder::initRetInstr(RegAlloca *regAlloca, RiscvInstr *returnInstr,
                                 RiscvBasicBlock *rbb, RiscvFunction *foo) {
   // 将被保护的寄存器还原
@@ -481,30 +753,50 @@ void RiscvBuilder::initRetInstr(RegAlloca *regAlloca, RiscvInstr *returnInstr,
                       returnInstr);
 }
 
+// 参数不超过 8 个整型与 8 个浮点寄存器，且调用者没有局部数组（其地址可能
+// 作为参数传入）时，尾调用可复用调用者的返回地址直接跳转
+bool RiscvBuilder::isSiblingCall(CallInst *call) {
+  if (!call->isTailCall())
+    return false;
+  int intCount = 0, floatCount = 0;
+  for (int i = 0; i + 1 < call->operands_.size(); i++)
+    if (call->operands_[i]->type_->tid_ == Type::FloatTyID)
+      floatCount++;
+    else
+      intCount++;
+  if (intCount > 8 || floatCount > 8)
+    return false;
+  for (auto bb : call->parent_->parent_->basic_blocks_)
+    for (auto instr : bb->instr_list_)
+      if (instr->is_alloca())
+        return false;
+  return true;
+}
+
 RiscvBasicBlock *RiscvBuilder::transferRiscvBasicBlock(BasicBlock *bb,
                                                        RiscvFunction *foo) {
   int translationCount = 0;
   RiscvBasicBlock *rbb = createRiscvBasicBlock(bb);
   Instruction *forward = nullptr; // 前置指令，用于icmp、fcmp和branch指令合并
-  bool brFound = false;
+  bool tailCalled = false;
+  // 比较结果只被紧随其后的条件跳转使用时，与跳转合并为比较跳转指令
+  auto fusable = [&](Instruction *instr) {
+    auto br = bb->instr_list_.back();
+    return bb->instr_list_.size() >= 2 && br->is_br() && br->num_ops_ == 3 &&
+           br->get_operand(0) == instr && instr->use_list_.size() == 1 &&
+           *std::prev(bb->instr_list_.end(), 2) == instr;
+  };
   for (Instruction *instr : bb->instr_list_) {
     switch (instr->op_id_) {
     case Instruction::Ret:
-      // Before leaving basic block writeback all registers
-      foo->regAlloca->writeback_all(rbb);
-      brFound = true;
       // 在翻译过程中先指ret，恢复寄存器等操作在第二遍扫描的时候再插入
       rbb->addInstrBack(this->createRetInstr(
           foo->regAlloca, static_cast<ReturnInst *>(instr), rbb, foo));
       break;
-    // 分支指令
+    // 分支指令，同时为后继块中的 phi 复制本块对应的入值
     case Instruction::Br:
-      // Before leaving basic block writeback all registers
-      foo->regAlloca->writeback_all(rbb);
-      brFound = true;
-
       rbb->addInstrBack(this->createBrInstr(
-          foo->regAlloca, static_cast<BranchInst *>(instr), rbb));
+          foo->regAlloca, static_cast<BranchInst *>(instr), rbb, forward));
       break;
     case Instruction::Add:
     case Instruction::Sub:
@@ -533,12 +825,16 @@ RiscvBasicBlock *RiscvBuilder::transferRiscvBasicBlock(BasicBlock *bb,
       // foo->regAlloca->writeback(static_cast<Value *>(instr), rbb);
       break;
     case Instruction::PHI:
+      // 前驱在跳转前已完成复制
       break;
     // 直接删除的指令
     case Instruction::BitCast:
-      break;
     case Instruction::ZExt:
-      // 等价一条合流语句操作
+      // 等价一条合流语句操作；操作数为常量时无法合并，需要复制
+      if (!foo->regAlloca->isMerged(instr))
+        foo->regAlloca->loadValue(
+            instr->operands_[0],
+            foo->regAlloca->findReg(instr, rbb, nullptr, 1, 0), rbb);
       break;
     case Instruction::Alloca:
       break;
@@ -575,11 +871,17 @@ RiscvBasicBlock *RiscvBuilder::transferRiscvBasicBlock(BasicBlock *bb,
       break;
     }
     case Instruction::ICmp:
-      createICMPSInstr(foo->regAlloca, static_cast<ICmpInst *>(instr), rbb);
+      if (fusable(instr))
+        forward = instr;
+      else
+        createICMPSInstr(foo->regAlloca, static_cast<ICmpInst *>(instr), rbb);
       // foo->regAlloca->writeback(static_cast<Value *>(instr), rbb);
       break;
     case Instruction::FCmp:
-      createFCMPInstr(foo->regAlloca, static_cast<FCmpInst *>(instr), rbb);
+      if (fusable(instr))
+        forward = instr;
+      else
+        createFCMPInstr(foo->regAlloca, static_cast<FCmpInst *>(instr), rbb);
       // foo->regAlloca->writeback(static_cast<Value *>(instr), rbb);
       break;
     case Instruction::Call: {
@@ -600,6 +902,23 @@ RiscvBasicBlock *RiscvBuilder::transferRiscvBasicBlock(BasicBlock *bb,
 
       int intRegCount = 0, floatRegCount = 0;
 
+      // 尾调用：参数全部经寄存器传递时，释放本函数栈帧后直接跳转到被调函数
+      if (isSiblingCall(curInstr)) {
+        std::vector<CopyPair> copies;
+        for (int i = 0; i < curInstr->operands_.size() - 1; i++) {
+          auto operand = curInstr->operands_[i];
+          std::string name =
+              operand->type_->tid_ == Type::FloatTyID
+                  ? "fa" + std::to_string(floatRegCount++)
+                  : "a" + std::to_string(intRegCount++);
+          copies.push_back({getRegOperand(name), operand, nullptr});
+        }
+        foo->regAlloca->parallelCopy(copies, rbb);
+        rbb->addInstrBack(new CallRiscvInst(calleeFoo, rbb, true));
+        tailCalled = true;
+        break;
+      }
+
       // 计算存储参数需要的额外栈帧大小
       for (int i = 0; i < curInstr->operands_.size() - 1; i++) {
         sp_shift_for_paras += VARIABLE_ALIGN_BYTE;
@@ -614,7 +933,8 @@ RiscvBasicBlock *RiscvBuilder::transferRiscvBasicBlock(BasicBlock *bb,
           BinaryRiscvInst::ADDI, getRegOperand("sp"),
           new RiscvConst(-sp_shift_for_paras), getRegOperand("sp"), rbb));
 
-      // 将参数移动至寄存器与内存中
+      // 额外的参数直接写入内存中，寄存器参数最后通过并行复制传入
+      std::vector<CopyPair> copies;
       for (int i = 0; i < curInstr->operands_.size() - 1; i++) {
         std::string name = "";
         auto operand = curInstr->operands_[i];
@@ -627,24 +947,20 @@ RiscvBasicBlock *RiscvBuilder::transferRiscvBasicBlock(BasicBlock *bb,
             name = "fa" + std::to_string(floatRegCount);
           floatRegCount++;
         }
-        // 将额外的参数直接写入内存中
         if (name.empty()) {
-          if (operand->type_->tid_ != Type::FloatTyID) {
-            rbb->addInstrBack(new StoreRiscvInst(
-                operand->type_,
-                foo->regAlloca->findSpecificReg(operand, "t1", rbb),
-                new RiscvIntPhiReg("sp", paraShift), rbb));
-          } else {
-            rbb->addInstrBack(new StoreRiscvInst(
-                operand->type_,
-                foo->regAlloca->findSpecificReg(operand, "ft1", rbb),
-                new RiscvIntPhiReg("sp", paraShift), rbb));
+          auto reg = foo->regAlloca->getPositionReg(operand);
+          if (reg == nullptr) {
+            reg = getRegOperand(
+                operand->type_->tid_ == Type::FloatTyID ? "ft1" : "t1");
+            foo->regAlloca->loadValue(operand, reg, rbb);
           }
-        } else {
-          foo->regAlloca->findSpecificReg(operand, name, rbb, nullptr);
-        }
+          rbb->addInstrBack(new StoreRiscvInst(
+              operand->type_, reg, new RiscvIntPhiReg("sp", paraShift), rbb));
+        } else
+          copies.push_back({getRegOperand(name), operand, nullptr});
         paraShift += VARIABLE_ALIGN_BYTE; // Add operand size lastly
       }
+      foo->regAlloca->parallelCopy(copies, rbb);
 
       // Call the function.
       rbb->addInstrBack(this->createCallInstr(foo->regAlloca, curInstr, rbb));
@@ -656,25 +972,22 @@ RiscvBasicBlock *RiscvBuilder::transferRiscvBasicBlock(BasicBlock *bb,
 
       // At last, save return value (a0) to target value.
       if (curInstr->type_->tid_ != curInstr->type_->VoidTyID) {
-        if (curInstr->type_->tid_ != curInstr->type_->FloatTyID) {
-          rbb->addInstrBack(
-              new StoreRiscvInst(new IntegerType(32), getRegOperand("a0"),
-                                 foo->regAlloca->findMem(curInstr), rbb));
-        } else {
-          rbb->addInstrBack(new StoreRiscvInst(
-              new Type(Type::FloatTyID), getRegOperand("fa0"),
-              foo->regAlloca->findMem(curInstr), rbb));
-        }
+        if (curInstr->type_->tid_ != curInstr->type_->FloatTyID)
+          foo->regAlloca->storeValue(curInstr, getRegOperand("a0"), rbb);
+        else
+          foo->regAlloca->storeValue(curInstr, getRegOperand("fa0"), rbb);
       }
       break;
     }
     }
-    // std::cout << "FINISH TRANSFER " << ++translationCount << "Codes\n";
-  }
-  // If br instruction is not found, then leave basic block at the block's end.
-  if (!brFound) {
+    // 尾调用之后的指令（跳转到返回块）不再执行
+    if (tailCalled)
+      break;
+    // 被溢出的结果写回栈上
     foo->regAlloca->writeback_all(rbb);
+    // std::cout << "FINISH TRANSFER " << ++translationCount << "Codes\n";
   }
+  foo->regAlloca->clear();
   return rbb;
 }
 
@@ -738,23 +1051,35 @@ std::string RiscvBuilder::buildRISCV(Module *m) {
   int ConstFloatCount = 0;
   std::string code = ".section .text\n";
   // 函数体
-  // 预处理：首先合并所有的合流语句操作，然后在分配单元（storeOnStack）部分使用DSU合并
-  for (Function *foo : m->function_list_) {
+  // 预处理：依次创建全部函数，合并所有的合流语句操作（分配单元部分使用DSU
+  // 合并），并为浮点常量分配名称，这些名称与全局数据按函数顺序生成
+  auto &functions = m->function_list_;
+  std::vector<RiscvFunction *> rfoos;
+  std::vector<RiscvBuilder> builders(functions.size(), *this);
+  int index = 0;
+  for (Function *foo : functions) {
     auto rfoo = createRiscvFunction(foo);
     rm->addFunction(rfoo);
+    rfoos.push_back(rfoo);
+    auto &builder = builders[index++];
     if (rfoo->is_libfunc()) {
-      auto *libFunc = createSyslibFunc(foo);
-      if (libFunc != nullptr)
-        code += libFunc->print();
+      // 库函数的代码体积很小，直接在此生成
+      auto *libFunc = createSyslibFunc(foo, &builder);
+      if (libFunc == nullptr)
+        rfoos.back() = nullptr;
       continue;
     }
+    // 操作数为常量时没有对应的位置，不进行合并
+    auto mergeable = [](Instruction *instr) {
+      return (instr->op_id_ == Instruction::OpID::ZExt ||
+              instr->op_id_ == Instruction::OpID::BitCast) &&
+             dynamic_cast<Constant *>(instr->operands_[0]) == nullptr;
+    };
     for (BasicBlock *bb : foo->basic_blocks_)
       for (Instruction *instr : bb->instr_list_)
-        if (instr->op_id_ == Instruction::OpID::PHI) {
-          for (auto *operand : instr->operands_)
-            rfoo->regAlloca->DSU_for_Variable.merge(
-                operand, static_cast<Value *>(instr));
-        } else if (instr->op_id_ == Instruction::OpID::ZExt) {
+        if (!mergeable(instr))
+          continue;
+        else if (instr->op_id_ == Instruction::OpID::ZExt) {
           rfoo->regAlloca->DSU_for_Variable.merge(instr->operands_[0],
                                                   static_cast<Value *>(instr));
         } else if (instr->op_id_ == Instruction::OpID::BitCast) {
@@ -782,171 +1107,202 @@ std::string RiscvBuilder::buildRISCV(Module *m) {
             rfoo->regAlloca->setPosition(Operand,
                                          new RiscvFloatPhiReg(curFloatName, 0));
           }
-    // 首先检查所有的alloca指令，加入一个基本块进行寄存器保护以及栈空间分配
-    RiscvBasicBlock *initBlock = createRiscvBasicBlock();
-    std::map<Value *, int> haveAllocated;
-    int IntParaCount = 0, FloatParaCount = 0;
-    int sp_shift_for_paras = 0;
-    int paraShift = 0;
-
-    rfoo->setSP(0); // set sp to 0 initially.
-
-    // Lambda function to write value to stack frame.
-    auto storeOnStack = [&](Value **val) {
-      if (val == nullptr)
-        return;
-      assert(*val != nullptr);
-      if (haveAllocated.count(*val))
-        return;
-      // 几种特殊类型，不需要分栈空间
-      if (dynamic_cast<Function *>(*val) != nullptr)
-        return;
-      if (dynamic_cast<BasicBlock *>(*val) != nullptr)
-        return;
-      // 注意：函数参数不用分配，而是直接指定！
-      // 这里设定是：v开头的是局部变量，arg开头的是函数寄存器变量
-      // 无名常量
-      if ((*val)->name_.empty())
-        return;
-      // 全局变量不用给他保存栈上地址，它本身就有对应的内存地址，直接忽略
-      if (dynamic_cast<GlobalVariable *>(*val) != nullptr) {
-        auto curType = (*val)->type_;
-        while (1) {
-          if (curType->tid_ == Type::TypeID::ArrayTyID)
-            curType = static_cast<ArrayType *>(curType)->contained_;
-          else if (curType->tid_ == Type::TypeID::PointerTyID)
-            curType = static_cast<PointerType *>(curType)->contained_;
-          else
-            break;
-        }
-        if (curType->tid_ != Type::TypeID::FloatTyID)
-          rfoo->regAlloca->setPosition(*val,
-                                       new RiscvIntPhiReg((*val)->name_, 0, 1));
+  }
+
+  // 各函数的代码互相独立，并行生成
+  getThreadPool().run(functions.size(), [&](int i) {
+    if (rfoos[i] != nullptr && !rfoos[i]->is_libfunc())
+      builders[i].buildFunction(functions[i], rfoos[i]);
+  });
+
+  // 按函数顺序统一为基本块编号，与逐个函数生成时的编号一致
+  int labelCount = 0;
+  for (auto &builder : builders)
+    for (auto rbb : builder.labels) {
+      rbb->name_ = toLabel(++labelCount);
+      rbb->blockInd_ = labelCount;
+    }
+
+  std::vector<std::string> codes(functions.size());
+  getThreadPool().run(functions.size(), [&](int i) {
+    if (rfoos[i] != nullptr)
+      codes[i] = rfoos[i]->print();
+  });
+  for (auto &str : codes)
+    code += str;
+  return data + code;
+}
+
+void RiscvBuilder::buildFunction(Function *foo, RiscvFunction *rfoo) {
+  // 寄存器分配：线性扫描，或在 -O2 下使用图着色
+  rfoo->regAlloca->allocate(foo, graphColoring);
+
+  // 首先检查所有的alloca指令，加入一个基本块进行寄存器保护以及栈空间分配
+  RiscvBasicBlock *initBlock = createRiscvBasicBlock();
+  std::map<Value *, int> haveAllocated;
+  std::map<Value *, RiscvOperand *> argReg; // 形参传入时所在的寄存器
+  int IntParaCount = 0, FloatParaCount = 0;
+  int sp_shift_for_paras = 0;
+  int paraShift = 0;
+
+  rfoo->setSP(0); // set sp to 0 initially.
+
+  // Lambda function to record the memory position of arguments and global
+  // variables.
+  auto storeOnStack = [&](Value **val) {
+    if (val == nullptr)
+      return;
+    assert(*val != nullptr);
+    if (haveAllocated.count(*val))
+      return;
+    // 全局变量不用给他保存栈上地址，它本身就有对应的内存地址，直接忽略
+    if (dynamic_cast<GlobalVariable *>(*val) != nullptr) {
+      auto curType = (*val)->type_;
+      while (1) {
+        if (curType->tid_ == Type::TypeID::ArrayTyID)
+          curType = static_cast<ArrayType *>(curType)->contained_;
+        else if (curType->tid_ == Type::TypeID::PointerTyID)
+          curType = static_cast<PointerType *>(curType)->contained_;
         else
-          rfoo->regAlloca->setPosition(
-              *val, new RiscvFloatPhiReg((*val)->name_, 0, 1));
-        return;
+          break;
       }
-      // 除了全局变量之外的参数
-      if (dynamic_cast<Argument *>(*val) != nullptr) {
-        // 不用额外分配空间
-        // 整型参数
-        if ((*val)->type_->tid_ == Type::TypeID::IntegerTyID ||
-            (*val)->type_->tid_ == Type::TypeID::PointerTyID) {
-          // Pointer type's size is set to 8 byte.
-          if (IntParaCount < 8)
-            rfoo->regAlloca->setPositionReg(
-                *val, getRegOperand("a" + std::to_string(IntParaCount)));
-          rfoo->regAlloca->setPosition(
-              *val, new RiscvIntPhiReg(NamefindReg("fp"), paraShift));
-          IntParaCount++;
-        }
-        // 浮点参数
-        else {
-          assert((*val)->type_->tid_ == Type::TypeID::FloatTyID);
-          // 寄存器有
-          if (FloatParaCount < 8) {
-            rfoo->regAlloca->setPositionReg(
-                *val, getRegOperand("fa" + std::to_string(FloatParaCount)));
-          }
-          rfoo->regAlloca->setPosition(
-              *val, new RiscvFloatPhiReg(NamefindReg("fp"), paraShift));
-          FloatParaCount++;
-        }
-        paraShift += VARIABLE_ALIGN_BYTE;
+      if (curType->tid_ != Type::TypeID::FloatTyID)
+        rfoo->regAlloca->setPosition(*val,
+                                     new RiscvIntPhiReg((*val)->name_, 0, 1));
+      else
+        rfoo->regAlloca->setPosition(
+            *val, new RiscvFloatPhiReg((*val)->name_, 0, 1));
+    }
+    // 函数参数：记录其传入的寄存器，以及调用者为其预留的栈上位置
+    else if (dynamic_cast<Argument *>(*val) != nullptr) {
+      // 整型参数
+      if ((*val)->type_->tid_ == Type::TypeID::IntegerTyID ||
+          (*val)->type_->tid_ == Type::TypeID::PointerTyID) {
+        // Pointer type's size is set to 8 byte.
+        if (IntParaCount < 8)
+          argReg[*val] = getRegOperand("a" + std::to_string(IntParaCount));
+        rfoo->regAlloca->setPosition(
+            *val, new RiscvIntPhiReg(NamefindReg("fp"), paraShift));
+        IntParaCount++;
       }
-      // 函数内变量
+      // 浮点参数
       else {
-        int curSP = rfoo->querySP();
-        RiscvOperand *stackPos = static_cast<RiscvOperand *>(
-            new RiscvIntPhiReg(NamefindReg("fp"), curSP - VARIABLE_ALIGN_BYTE));
-        rfoo->regAlloca->setPosition(static_cast<Value *>(*val), stackPos);
-        rfoo->addTempVar(stackPos);
+        assert((*val)->type_->tid_ == Type::TypeID::FloatTyID);
+        if (FloatParaCount < 8)
+          argReg[*val] = getRegOperand("fa" + std::to_string(FloatParaCount));
+        rfoo->regAlloca->setPosition(
+            *val, new RiscvFloatPhiReg(NamefindReg("fp"), paraShift));
+        FloatParaCount++;
       }
-      haveAllocated[*val] = 1;
-    };
-
-    // 关联函数参数、寄存器与内存
-    for (Value *arg : foo->arguments_)
-      storeOnStack(&arg);
+      paraShift += VARIABLE_ALIGN_BYTE;
+    } else
+      return;
+    haveAllocated[*val] = 1;
+  };
 
-    for (BasicBlock *bb : foo->basic_blocks_)
-      for (Instruction *instr : bb->instr_list_)
-        if (instr->op_id_ != Instruction::OpID::PHI &&
-            instr->op_id_ != Instruction::OpID::ZExt &&
-            instr->op_id_ != Instruction::OpID::Alloca) {
-          // 所有的函数局部变量都要压入栈
-          Value *tempPtr = static_cast<Value *>(instr);
-          storeOnStack(&tempPtr);
-          for (auto *val : instr->operands_) {
-            tempPtr = static_cast<Value *>(val);
-            storeOnStack(&tempPtr);
-          }
-        }
-    for (BasicBlock *bb : foo->basic_blocks_)
-      for (Instruction *instr : bb->instr_list_)
-        if (instr->op_id_ == Instruction::OpID::Alloca) {
-          // 分配指针，并且将指针地址也同步保存
-          auto curInstr = static_cast<AllocaInst *>(instr);
-          int curTypeSize = calcTypeSize(curInstr->alloca_ty_);
-          rfoo->storeArray(curTypeSize);
-          int curSP = rfoo->querySP();
-          RiscvOperand *ptrPos = new RiscvIntPhiReg(NamefindReg("fp"), curSP);
-          rfoo->regAlloca->setPosition(static_cast<Value *>(instr), ptrPos);
-          rfoo->regAlloca->setPointerPos(static_cast<Value *>(instr), ptrPos);
-        }
+  // 关联函数参数、寄存器与内存
+  for (Value *arg : foo->arguments_)
+    storeOnStack(&arg);
 
-    // 添加初始化基本块
-    rfoo->addBlock(initBlock);
-    // 翻译语句并计算被使用的寄存器
-    for (BasicBlock *bb : foo->basic_blocks_)
-      rfoo->addBlock(this->transferRiscvBasicBlock(bb, rfoo));
-    rfoo->ChangeBlock(initBlock, 0);
-
-    // 保护寄存器
-    rfoo->shiftSP(-VARIABLE_ALIGN_BYTE);
-    int fp_sp = rfoo->querySP(); // 为保护 fp 分配空间
-    auto &reg_to_save = rfoo->regAlloca->savedRegister;
-    auto reg_used = rfoo->regAlloca->getUsedReg();
-    for (auto reg : reg_to_save)
-      if (reg_used.find(reg) != reg_used.end()) {
-        rfoo->shiftSP(-VARIABLE_ALIGN_BYTE);
-        if (reg->getType() == reg->IntReg)
-          initBlock->addInstrBack(new StoreRiscvInst(
-              new Type(Type::PointerTyID), reg,
-              new RiscvIntPhiReg(NamefindReg("fp"), rfoo->querySP()),
-              initBlock));
-        else
-          initBlock->addInstrBack(new StoreRiscvInst(
-              new Type(Type::FloatTyID), reg,
-              new RiscvIntPhiReg(NamefindReg("fp"), rfoo->querySP()),
-              initBlock));
+  for (BasicBlock *bb : foo->basic_blocks_)
+    for (Instruction *instr : bb->instr_list_)
+      for (auto *val : instr->operands_) {
+        Value *tempPtr = static_cast<Value *>(val);
+        storeOnStack(&tempPtr);
+      }
+  // 被溢出的变量分配栈位；经栈传入的形参直接使用调用者预留的位置
+  for (Value *val : rfoo->regAlloca->spilled) {
+    if (dynamic_cast<Argument *>(val) != nullptr && argReg.count(val) == 0)
+      continue;
+    int curSP = rfoo->querySP();
+    RiscvOperand *stackPos = static_cast<RiscvOperand *>(
+        new RiscvIntPhiReg(NamefindReg("fp"), curSP - VARIABLE_ALIGN_BYTE));
+    rfoo->regAlloca->setPosition(val, stackPos);
+    rfoo->addTempVar(stackPos);
+  }
+  for (BasicBlock *bb : foo->basic_blocks_)
+    for (Instruction *instr : bb->instr_list_)
+      if (instr->op_id_ == Instruction::OpID::Alloca) {
+        // 分配指针，并且将指针地址也同步保存
+        auto curInstr = static_cast<AllocaInst *>(instr);
+        int curTypeSize = calcTypeSize(curInstr->alloca_ty_);
+        rfoo->storeArray(curTypeSize);
+        int curSP = rfoo->querySP();
+        RiscvOperand *ptrPos = new RiscvIntPhiReg(NamefindReg("fp"), curSP);
+        rfoo->regAlloca->setPosition(static_cast<Value *>(instr), ptrPos);
+        rfoo->regAlloca->setPointerPos(static_cast<Value *>(instr), ptrPos);
       }
 
-    // 分配整体的栈空间，并设置s0为原sp
-    initBlock->addInstrFront(new BinaryRiscvInst(
-        RiscvInstr::ADDI, getRegOperand("sp"), new RiscvConst(-rfoo->querySP()),
-        getRegOperand("fp"),
-        initBlock)); // 3: fp <- t0
-    initBlock->addInstrFront(new StoreRiscvInst(
-        new Type(Type::PointerTyID), getRegOperand("fp"),
-        new RiscvIntPhiReg(NamefindReg("sp"), fp_sp - rfoo->querySP()),
-        initBlock)); // 2: 保护 fp
-    initBlock->addInstrFront(new BinaryRiscvInst(
-        RiscvInstr::ADDI, getRegOperand("sp"), new RiscvConst(rfoo->querySP()),
-        getRegOperand("sp"), initBlock)); // 1: 分配栈帧
-
-    // 扫描所有的返回语句并插入寄存器还原等相关内容
-    for (RiscvBasicBlock *rbb : rfoo->blk)
-      for (RiscvInstr *rinstr : rbb->instruction)
-        if (rinstr->type_ == rinstr->RET) {
-          initRetInstr(rfoo->regAlloca, rinstr, rbb, rfoo);
-          break;
-        }
+  // 添加初始化基本块
+  rfoo->addBlock(initBlock);
+  // 翻译语句并计算被使用的寄存器
+  edgeBlocks.clear();
+  for (BasicBlock *bb : foo->basic_blocks_)
+    rfoo->addBlock(this->transferRiscvBasicBlock(bb, rfoo));
+  // 关键边上的基本块均以跳转结束，放在函数末尾
+  for (RiscvBasicBlock *edge : edgeBlocks)
+    rfoo->addBlock(edge);
+  rfoo->ChangeBlock(initBlock, 0);
+
+  // 保护寄存器
+  rfoo->shiftSP(-VARIABLE_ALIGN_BYTE);
+  int fp_sp = rfoo->querySP(); // 为保护 fp 分配空间
+  auto &reg_to_save = rfoo->regAlloca->savedRegister;
+  auto reg_used = rfoo->regAlloca->getUsedReg();
+  for (auto reg : reg_to_save)
+    if (reg_used.find(reg) != reg_used.end()) {
+      rfoo->shiftSP(-VARIABLE_ALIGN_BYTE);
+      if (reg->getType() == reg->IntReg)
+        initBlock->addInstrBack(new StoreRiscvInst(
+            new Type(Type::PointerTyID), reg,
+            new RiscvIntPhiReg(NamefindReg("fp"), rfoo->querySP()),
+            initBlock));
+      else
+        initBlock->addInstrBack(new StoreRiscvInst(
+            new Type(Type::FloatTyID), reg,
+            new RiscvIntPhiReg(NamefindReg("fp"), rfoo->querySP()),
+            initBlock));
+    }
 
-    code += rfoo->print();
+  // 形参从传入位置移动到分配的位置
+  std::vector<CopyPair> argCopies;
+  for (Value *arg : foo->arguments_)
+    if (!arg->use_list_.empty() && argReg.count(arg))
+      argCopies.push_back(
+          {rfoo->regAlloca->getLocation(arg), arg, argReg[arg]});
+  rfoo->regAlloca->parallelCopy(argCopies, initBlock);
+  for (Value *arg : foo->arguments_) {
+    auto reg = rfoo->regAlloca->getPositionReg(arg);
+    if (!arg->use_list_.empty() && !argReg.count(arg) && reg != nullptr)
+      initBlock->addInstrBack(new LoadRiscvInst(
+          arg->type_, reg, rfoo->regAlloca->findMem(arg), initBlock));
   }
-  return data + code;
+
+  // 分配整体的栈空间，并设置s0为原sp
+  initBlock->addInstrFront(new BinaryRiscvInst(
+      RiscvInstr::ADDI, getRegOperand("sp"), new RiscvConst(-rfoo->querySP()),
+      getRegOperand("fp"),
+      initBlock)); // 3: fp <- t0
+  initBlock->addInstrFront(new StoreRiscvInst(
+      new Type(Type::PointerTyID), getRegOperand("fp"),
+      new RiscvIntPhiReg(NamefindReg("sp"), fp_sp - rfoo->querySP()),
+      initBlock)); // 2: 保护 fp
+  initBlock->addInstrFront(new BinaryRiscvInst(
+      RiscvInstr::ADDI, getRegOperand("sp"), new RiscvConst(rfoo->querySP()),
+      getRegOperand("sp"), initBlock)); // 1: 分配栈帧
+
+  // 扫描所有的返回语句与尾调用并插入寄存器还原等相关内容
+  for (RiscvBasicBlock *rbb : rfoo->blk)
+    for (RiscvInstr *rinstr : rbb->instruction)
+      if (rinstr->type_ == rinstr->RET ||
+          (rinstr->type_ == rinstr->CALL &&
+           static_cast<CallRiscvInst *>(rinstr)->isTail)) {
+        initRetInstr(rfoo->regAlloca, rinstr, rbb, rfoo);
+        break;
+      }
+
+  // 窥孔优化
+  OptimizeFunction(rfoo);
 }
 
 /**
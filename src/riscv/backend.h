@@ -10,13 +10,9 @@
 // 建立IR到RISCV指令集的映射
 const extern std::map<Instruction::OpID, RiscvInstr::InstrType> toRiscvOp;
 
-extern int LabelCount;
-extern std::map<BasicBlock *, RiscvBasicBlock *> rbbLabel;
+// 全部函数在生成代码之前依次创建，此后只读，可在多个线程中共享
 extern std::map<Function *, RiscvFunction *> functionLabel;
 
-// 下面的函数仅为一个basic
-// block产生一个标号，指令集为空，需要使用总控程序中具体遍历该bb才会产生内部指令
-RiscvBasicBlock *createRiscvBasicBlock(BasicBlock *bb = nullptr);
 RiscvFunction *createRiscvFunction(Function *foo = nullptr);
 std::string toLabel(int ind);
 int calcTypeSize(Type *ty);
@@ -32,9 +28,24 @@ public:
     initializeRegisterFile();
   }
   RiscvModule *rm;
-  // phi语句的合流：此处建立一个并查集DSU_for_Variable维护相同的变量。
-  // 例如，对于if (A) y1=do something else y2=do another thing. Phi y3 y1, y2
+  // 各函数的代码并行生成，每个函数使用总控程序的一个副本，
+  // 基本块先在副本内编号，全部生成后再按函数顺序统一编号，
+  // 因此输出与线程数及执行顺序无关。
+  std::map<BasicBlock *, RiscvBasicBlock *> rbbLabel;
+  std::vector<RiscvBasicBlock *> labels; // 按创建顺序记录的基本块
+  // phi语句的合流：在每条入边上对后继块的全部 phi 进行并行复制，
+  // 关键边上新建基本块完成复制，这些基本块记录在 edgeBlocks 中。
+  // zext 与 bitcast 仍通过并查集 DSU_for_Variable 与其操作数合并。
+  std::vector<RiscvBasicBlock *> edgeBlocks;
+  // 使用图着色（而非线性扫描）进行寄存器分配，在 -O2 下启用
+  bool graphColoring = false;
   std::string buildRISCV(Module *m);
+  // 为函数 foo 生成代码，只访问 rfoo 与该副本自身的状态
+  void buildFunction(Function *foo, RiscvFunction *rfoo);
+
+  // 下面的函数仅为一个basic block产生一个标号，指令集为空，
+  // 需要使用总控程序中具体遍历该bb才会产生内部指令
+  RiscvBasicBlock *createRiscvBasicBlock(BasicBlock *bb = nullptr);
 
   // 下面的语句是需要生成对应riscv语句
   // Zext语句零扩展，因而没有必要
@@ -43,6 +54,10 @@ public:
   BinaryRiscvInst *createBinaryInstr(RegAlloca *regAlloca,
                                      BinaryInst *binaryInstr,
                                      RiscvBasicBlock *rbb);
+  // 乘、除、取余的一个操作数为常量时改用移位、加法与乘法高位实现，
+  // 成功生成时返回 true
+  bool solveConstMulDiv(RegAlloca *regAlloca, BinaryInst *binaryInstr,
+                        RiscvBasicBlock *rbb);
   UnaryRiscvInst *createUnaryInstr(RegAlloca *regAlloca, UnaryInst *unaryInstr,
                                    RiscvBasicBlock *rbb);
   std::vector<RiscvInstr *> createStoreInstr(RegAlloca *regAlloca,
@@ -51,12 +66,17 @@ public:
   std::vector<RiscvInstr *> createLoadInstr(RegAlloca *regAlloca,
                                             LoadInst *loadInstr,
                                             RiscvBasicBlock *rbb);
+  // 与条件跳转合并的整型比较，直接跳转到 trueLink 或 falseLink
   ICmpRiscvInstr *createICMPInstr(RegAlloca *regAlloca, ICmpInst *icmpInstr,
-                                  BranchInst *brInstr, RiscvBasicBlock *rbb);
+                                  RiscvBasicBlock *trueLink,
+                                  RiscvBasicBlock *falseLink,
+                                  RiscvBasicBlock *rbb);
   ICmpRiscvInstr *createICMPSInstr(RegAlloca *regAlloca, ICmpInst *icmpInstr,
                                    RiscvBasicBlock *rbb);
+  // dest 不为空时将比较结果写入 dest 而非 fcmpInstr 所分配的位置
   RiscvInstr *createFCMPInstr(RegAlloca *regAlloca, FCmpInst *fcmpInstr,
-                              RiscvBasicBlock *rbb);
+                              RiscvBasicBlock *rbb,
+                              RiscvOperand *dest = nullptr);
   SiToFpRiscvInstr *createSiToFpInstr(RegAlloca *regAlloca,
                                       SiToFpInst *sitofpInstr,
                                       RiscvBasicBlock *rbb);
@@ -68,11 +88,30 @@ public:
   RiscvBasicBlock *transferRiscvBasicBlock(BasicBlock *bb, RiscvFunction *foo);
   ReturnRiscvInst *createRetInstr(RegAlloca *regAlloca, ReturnInst *returnInstr,
                                   RiscvBasicBlock *rbb, RiscvFunction *rfoo);
-  BranchRiscvInstr *createBrInstr(RegAlloca *regAlloca, BranchInst *brInstr,
-                                  RiscvBasicBlock *rbb);
+  // cmpInstr 为与该跳转合并的比较指令（可为空）
+  RiscvInstr *createBrInstr(RegAlloca *regAlloca, BranchInst *brInstr,
+                            RiscvBasicBlock *rbb,
+                            Instruction *cmpInstr = nullptr);
   RiscvInstr *solveGetElementPtr(RegAlloca *regAlloca, GetElementPtrInst *instr,
                                  RiscvBasicBlock *rbb);
 
+  /**
+   * 返回边 bb -> succ 上 phi 所需的复制，入值已位于 phi 所在位置的复制被省略。
+   */
+  std::vector<CopyPair> getPhiCopy(RegAlloca *regAlloca, BasicBlock *bb,
+                                   BasicBlock *succ);
+
+  /**
+   * 在 rbb 末尾插入边 bb -> succ 上 phi 的并行复制。
+   */
+  void solvePhiCopy(RegAlloca *regAlloca, BasicBlock *bb, BasicBlock *succ,
+                    RiscvBasicBlock *rbb);
+
+  /**
+   * 判断调用能否翻译为尾调用（tail），直接复用调用者的返回地址。
+   */
+  bool isSiblingCall(CallInst *call);
+
   /**
    * 在返回语句前插入必要的语句。
    */
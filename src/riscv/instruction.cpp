@@ -61,12 +61,12 @@ std::string print_cmp_type(ICmpInst::ICmpOp op);
 std::string print_fcmp_type(FCmpInst::FCmpOp op);
 
 RiscvInstr::RiscvInstr(InstrType type, int op_nums)
-    : type_(type), parent_(nullptr) {
+    : type_(type), parent_(nullptr), result_(nullptr) {
   operand_.resize(op_nums);
 }
 
 RiscvInstr::RiscvInstr(InstrType type, int op_nums, RiscvBasicBlock *bb)
-    : type_(type), parent_(bb) {
+    : type_(type), parent_(bb), result_(nullptr) {
   operand_.resize(op_nums);
 }
 
@@ -77,8 +77,7 @@ std::string BinaryRiscvInst::print() {
   std::string riscv_instr = "\t\t";
 
   bool overflow = false;
-  if (type_ == ADDI &&
-      std::abs(static_cast<RiscvConst *>(operand_[1])->intval) >= 1024) {
+  if (type_ == ADDI && !isImm12(static_cast<RiscvConst *>(operand_[1])->intval)) {
     overflow = true;
     type_ = ADD;
     riscv_instr += "LI\tt6, " + operand_[1]->print();
@@ -86,8 +85,10 @@ std::string BinaryRiscvInst::print() {
   }
 
   riscv_instr += instrTy2Riscv.at(this->type_);
-  if (word && (type_ == ADDI || type_ == ADD || type_ == MUL || type_ == REM ||
-               type_ == DIV))
+  if (word && (type_ == ADDI || type_ == ADD || type_ == SUB || type_ == MUL ||
+               type_ == REM || type_ == DIV || type_ == SHL || type_ == ASHR ||
+               type_ == LSHR || type_ == SHLI || type_ == ASHRI ||
+               type_ == LSHRI))
     riscv_instr += "W"; // Integer word type instruction.
   riscv_instr += "\t";
   riscv_instr += this->result_->print();
@@ -116,7 +117,7 @@ std::string UnaryRiscvInst::print() {
 }
 
 std::string CallRiscvInst::print() {
-  std::string riscv_instr = "\t\tCALL\t";
+  std::string riscv_instr = isTail ? "\t\tTAIL\t" : "\t\tCALL\t";
   riscv_instr += static_cast<RiscvFunction *>(this->operand_[0])->name_;
   riscv_instr += "\n";
   return riscv_instr;
@@ -185,8 +186,10 @@ std::string ICmpSRiscvInstr::print() {
     break;
   }
 
+  // 与立即数比较：SUB 改用 XORI，SLT/SLTU 改用 SLTI/SLTIU
+  bool imm = operand_[1]->getType() == RiscvOperand::IntImm;
   if (eorne) {
-    riscv_instr += "SUB\t";
+    riscv_instr += imm ? "XORI\t" : "SUB\t";
     riscv_instr += "t6";
     riscv_instr += ", ";
     riscv_instr += operand_[0]->print();
@@ -195,7 +198,10 @@ std::string ICmpSRiscvInstr::print() {
     riscv_instr += "\n\t\t";
   }
 
-  riscv_instr += ICmpOpSName.at(this->icmp_op_) + "\t";
+  auto name = ICmpOpSName.at(this->icmp_op_);
+  if (imm && !eorne)
+    name = name == "SLT" ? "SLTI" : "SLTIU";
+  riscv_instr += name + "\t";
   riscv_instr += this->result_->print();
   riscv_instr += ", ";
   if (!eorne) {
@@ -68,6 +68,9 @@ public:
   std::string print();
 };
 
+// 判断常量能否作为 I 型指令的 12 位有符号立即数
+inline bool isImm12(long long val) { return val >= -2048 && val < 2048; }
+
 // 传入寄存器编号以生成一条语句，
 // 上层由basic block整合
 class RiscvInstr {
@@ -164,8 +167,11 @@ public:
     setOperand(1, v2);
     setResult(target);
     this->parent_ = bb;
-    // Optimize: 若立即数为0，则改用寄存器zero。
-    if(v2->getType() == v2->IntImm && static_cast<RiscvConst*>(v2)->intval == 0){
+    // Optimize: 若立即数为0且运算结果等于另一操作数，则改用寄存器zero。
+    if ((op == ADDI || op == ORI || op == XORI || op == SHLI || op == ASHRI ||
+         op == LSHRI) &&
+        v2->getType() == v2->IntImm &&
+        static_cast<RiscvConst *>(v2)->intval == 0) {
       type_ = ADD;
       setOperand(1, getRegOperand("zero"));
     }
@@ -249,8 +255,10 @@ public:
 // 0作为函数名，1-n是函数各参数
 class CallRiscvInst : public RiscvInstr {
 public:
-  CallRiscvInst(RiscvFunction *func, RiscvBasicBlock *bb)
-      : RiscvInstr(InstrType::CALL, 1, bb) {
+  // 尾调用：栈帧已在调用前释放，直接跳转到被调函数，由其返回到本函数的调用者
+  bool isTail;
+  CallRiscvInst(RiscvFunction *func, RiscvBasicBlock *bb, bool isTail = false)
+      : RiscvInstr(InstrType::CALL, 1, bb), isTail(isTail) {
     setOperand(0, func);
   }
   virtual std::string print() override;
@@ -1,3 +1,211 @@
 #include "optimize.h"
 
-void OptimizeBlock() {}
\ No newline at end of file
+// 指令写入的寄存器名，不写寄存器时返回空串
+static std::string defReg(RiscvInstr *instr) {
+  switch (instr->type_) {
+  case RiscvInstr::LI:
+  case RiscvInstr::MOV:
+  case RiscvInstr::FMV:
+  case RiscvInstr::LW:
+  case RiscvInstr::LA:
+    return instr->operand_[0]->print();
+  case RiscvInstr::FPTOSI:
+  case RiscvInstr::SITOFP:
+    return instr->operand_[1]->print();
+  default:
+    return instr->result_ != nullptr ? instr->result_->print() : "";
+  }
+}
+
+static bool isMem(RiscvOperand *op) {
+  return op->tid_ == RiscvOperand::IntMem || op->tid_ == RiscvOperand::FloatMem;
+}
+
+// 访存操作数的基址寄存器名，全局变量直接寻址时返回空串
+static std::string memBase(RiscvOperand *op) {
+  if (op->tid_ == RiscvOperand::IntMem) {
+    auto mem = static_cast<RiscvIntPhiReg *>(op);
+    return mem->isGlobalVariable ? "" : mem->MemBaseName;
+  }
+  auto mem = static_cast<RiscvFloatPhiReg *>(op);
+  return mem->isGlobalVariable ? "" : mem->MemBaseName;
+}
+
+// 指令是否读取寄存器 reg 。函数调用与返回保守地视为读取全部非临时寄存器
+static bool usesReg(RiscvInstr *instr, const std::string &reg) {
+  if (instr->type_ == RiscvInstr::CALL || instr->type_ == RiscvInstr::RET)
+    return reg[0] != 't' && reg.substr(0, 2) != "ft";
+  int skip = -1; // 被写入的操作数下标
+  switch (instr->type_) {
+  case RiscvInstr::LI:
+  case RiscvInstr::MOV:
+  case RiscvInstr::FMV:
+  case RiscvInstr::LW:
+  case RiscvInstr::LA:
+    skip = 0;
+    break;
+  case RiscvInstr::FPTOSI:
+  case RiscvInstr::SITOFP:
+    skip = 1;
+    break;
+  default:
+    break;
+  }
+  for (int i = 0; i < instr->operand_.size(); i++) {
+    auto op = instr->operand_[i];
+    if (i == skip || op == nullptr)
+      continue;
+    if (op->isRegister() && op->print() == reg)
+      return true;
+    if (isMem(op) && memBase(op) == reg)
+      return true;
+  }
+  return false;
+}
+
+// 临时寄存器 reg 在 instr[pos] 之后是否不再被读取
+static bool deadAfter(std::vector<RiscvInstr *> &instr, int pos,
+                      const std::string &reg) {
+  if (reg[0] != 't')
+    return false;
+  for (int i = pos + 1; i < instr.size(); i++) {
+    if (usesReg(instr[i], reg))
+      return false;
+    if (defReg(instr[i]) == reg || instr[i]->type_ == RiscvInstr::CALL)
+      return true;
+  }
+  return true;
+}
+
+static bool isZero(RiscvOperand *op) {
+  return (op->tid_ == RiscvOperand::IntImm &&
+          static_cast<RiscvConst *>(op)->intval == 0) ||
+         (op->isRegister() && op->print() == "zero");
+}
+
+// 规则：删除自身到自身的复制 mv x, x
+static bool removeSelfMove(std::vector<RiscvInstr *> &instr, int i) {
+  auto cur = instr[i];
+  if ((cur->type_ != RiscvInstr::MOV && cur->type_ != RiscvInstr::FMV) ||
+      cur->operand_[0]->print() != cur->operand_[1]->print())
+    return false;
+  instr.erase(instr.begin() + i);
+  return true;
+}
+
+// 规则：删除 addi x, x, 0（构造时已改写为 add x, x, zero），
+// 目标与源不同时改写为 mv
+static bool removeAddZero(std::vector<RiscvInstr *> &instr, int i) {
+  auto cur = instr[i];
+  if (cur->type_ != RiscvInstr::ADD && cur->type_ != RiscvInstr::ADDI)
+    return false;
+  // 字长指令还带有符号扩展的作用
+  if (static_cast<BinaryRiscvInst *>(cur)->word || !isZero(cur->operand_[1]))
+    return false;
+  if (cur->result_->print() == cur->operand_[0]->print())
+    instr.erase(instr.begin() + i);
+  else
+    instr[i] = new MoveRiscvInst(cur->result_, cur->operand_[0], cur->parent_);
+  return true;
+}
+
+// 规则：li t, imm; add d, a, t  =>  addi d, a, imm（t 此后不再被读取）
+static bool foldLiAdd(std::vector<RiscvInstr *> &instr, int i) {
+  if (i + 1 >= instr.size() || instr[i]->type_ != RiscvInstr::LI ||
+      instr[i + 1]->type_ != RiscvInstr::ADD)
+    return false;
+  auto li = instr[i];
+  auto add = static_cast<BinaryRiscvInst *>(instr[i + 1]);
+  int imm = static_cast<RiscvConst *>(li->operand_[1])->intval;
+  auto t = li->operand_[0]->print();
+  if (!isImm12(imm))
+    return false;
+  RiscvOperand *other = nullptr;
+  if (add->operand_[1]->print() == t)
+    other = add->operand_[0];
+  else if (add->operand_[0]->print() == t)
+    other = add->operand_[1];
+  if (other == nullptr || !other->isRegister() || other->print() == t ||
+      !deadAfter(instr, i + 1, t))
+    return false;
+  auto addi = new BinaryRiscvInst(RiscvInstr::ADDI, other, new RiscvConst(imm),
+                                  add->result_, add->parent_, add->word);
+  instr.erase(instr.begin() + i);
+  instr[i] = addi;
+  return true;
+}
+
+// 规则：sw x, slot 之后读取同一栈位的 lw y, slot 改写为 mv y, x 或直接删除。
+// 两者之间不能有函数调用或可能写同一位置的存储，也不能改写 x 与 slot 的基址寄存器。
+// 以 fp 为基址直接访问的只有标量栈位（8 字节对齐），偏移量不同即不重叠。
+static bool forwardStore(std::vector<RiscvInstr *> &instr, int i) {
+  if (instr[i]->type_ != RiscvInstr::SW)
+    return false;
+  auto store = static_cast<StoreRiscvInst *>(instr[i]);
+  auto src = store->operand_[0]->print();
+  auto slot = store->operand_[1]->print();
+  auto base = memBase(store->operand_[1]);
+  if (base.empty())
+    return false;
+  bool change = false;
+  for (int j = i + 1; j < instr.size(); j++) {
+    auto cur = instr[j];
+    if (cur->type_ == RiscvInstr::SW && base == "fp" &&
+        memBase(cur->operand_[1]) == "fp" && cur->operand_[1]->print() != slot)
+      continue;
+    if (cur->type_ == RiscvInstr::SW || cur->type_ == RiscvInstr::CALL ||
+        cur->type_ == RiscvInstr::RET || cur->type_ == RiscvInstr::BGT ||
+        cur->type_ == RiscvInstr::ICMP)
+      break;
+    if (cur->type_ == RiscvInstr::LW &&
+        static_cast<LoadRiscvInst *>(cur)->type.tid_ == store->type.tid_ &&
+        cur->operand_[1]->print() == slot) {
+      if (cur->operand_[0]->print() == src)
+        instr.erase(instr.begin() + j--);
+      else
+        instr[j] = new MoveRiscvInst(cur->operand_[0], store->operand_[0],
+                                     cur->parent_);
+      change = true;
+      cur = instr[j];
+    }
+    auto def = defReg(cur);
+    if (def == src || def == base)
+      break;
+  }
+  return change;
+}
+
+static bool (*const peepholeRules[])(std::vector<RiscvInstr *> &, int) = {
+    removeSelfMove, removeAddZero, foldLiAdd, forwardStore};
+
+void OptimizeBlock(RiscvBasicBlock *rbb) {
+  auto &instr = rbb->instruction;
+  bool change = true;
+  while (change) {
+    change = false;
+    for (int i = 0; i < instr.size(); i++)
+      for (auto rule : peepholeRules)
+        if (i < instr.size() && rule(instr, i))
+          change = true;
+  }
+}
+
+void OptimizeFunction(RiscvFunction *rfoo) {
+  for (auto rbb : rfoo->blk)
+    OptimizeBlock(rbb);
+  // 跳转目标恰为下一基本块时省略无条件跳转
+  for (int i = 0; i + 1 < rfoo->blk.size(); i++) {
+    auto &instr = rfoo->blk[i]->instruction;
+    auto next = rfoo->blk[i + 1];
+    if (instr.empty())
+      continue;
+    auto last = instr.back();
+    if (last->type_ == RiscvInstr::BGT && last->operand_[2] == next) {
+      if (last->operand_[0] == nullptr)
+        instr.pop_back();
+      else
+        last->setOperand(2, nullptr);
+    } else if (last->type_ == RiscvInstr::ICMP && last->operand_[3] == next)
+      last->setOperand(3, nullptr);
+  }
+}
@@ -1,11 +1,23 @@
 #ifndef OPTIMIZEH
 #define OPTIMIZEH
 
-#include "riscv.h"
+#include "instruction.h"
 #include "ir.h"
+#include "riscv.h"
+
+// 窥孔优化：在指令选择与寄存器分配完成后，对各基本块的指令序列进行局部改写。
+// 每条规则从指令序列的某一位置开始匹配，匹配成功时就地改写并返回 true ，
+// 对一个基本块反复应用全部规则直到不再变化。
+// 临时寄存器 t0-t6 只在一条 IR 指令的翻译内部使用，不会跨越基本块活跃。
+
+/**
+ * 对基本块 rbb 的指令序列应用全部窥孔规则。
+ */
+void OptimizeBlock(RiscvBasicBlock *rbb);
 
-// 进行数据流的优化
-// 在此之前先分配各寄存器
-// 可选
-void OptimizeBlock();
-#endif // !OPTIMIZEH
\ No newline at end of file
+/**
+ * 对函数的各基本块进行窥孔优化，并删除跳转到下一基本块的无条件跳转。
+ * @attention 需要在函数的全部指令（含入口与返回处的现场保护）生成后调用。
+ */
+void OptimizeFunction(RiscvFunction *rfoo);
+#endif // !OPTIMIZEH
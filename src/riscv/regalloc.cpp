@@ -1,8 +1,8 @@
 #include "regalloc.h"
 #include "instruction.h"
 #include "riscv.h"
-
-int IntRegID = 32, FloatRegID = 32; // 测试阶段使用
+#include "utils.h"
+#include <algorithm>
 
 Register *NamefindReg(std::string reg) {
   if (reg.size() > 4)
@@ -28,8 +28,21 @@ Register *NamefindReg(std::string reg) {
   return nullptr;
 }
 
+// 寄存器对象池，首次使用时创建，此后只读，可在多个线程中共享
+static const std::vector<RiscvOperand *> &getRegPool() {
+  static const std::vector<RiscvOperand *> regPool = [] {
+    std::vector<RiscvOperand *> pool;
+    for (int i = 0; i < 32; i++)
+      pool.push_back(new RiscvIntReg(new Register(Register::Int, i)));
+    for (int i = 0; i < 32; i++)
+      pool.push_back(new RiscvFloatReg(new Register(Register::Float, i)));
+    return pool;
+  }();
+  return regPool;
+}
+
 RiscvOperand *getRegOperand(std::string reg) {
-  for (auto regope : regPool) {
+  for (auto regope : getRegPool()) {
     if (regope->print() == reg)
       return regope;
   }
@@ -39,7 +52,7 @@ RiscvOperand *getRegOperand(std::string reg) {
 
 RiscvOperand *getRegOperand(Register::RegType op_ty_, int id) {
   Register *reg = new Register(op_ty_, id);
-  for (auto regope : regPool) {
+  for (auto regope : getRegPool()) {
     if (regope->print() == reg->print()) {
       delete reg;
       return regope;
@@ -55,107 +68,453 @@ Type *getStoreTypeFromRegType(RiscvOperand *riscvReg) {
              : new Type(Type::TypeID::IntegerTyID);
 }
 
-RiscvOperand *RegAlloca::findReg(Value *val, RiscvBasicBlock *bb,
-                                 RiscvInstr *instr, int inReg, int load,
-                                 RiscvOperand *specified, bool direct) {
-  safeFindTimeStamp++;
-  val = this->DSU_for_Variable.query(val);
-  bool isGVar = dynamic_cast<GlobalVariable *>(val) != nullptr;
-  bool isAlloca = dynamic_cast<AllocaInst *>(val) != nullptr;
-  bool isPointer = val->type_->tid_ == val->type_->PointerTyID;
-
-  // If there is no register allocated for value then get a new one
-  if (specified != nullptr)
-    setPositionReg(val, specified, bb, instr);
-  else if (curReg.find(val) == curReg.end() || isAlloca ||
-           val->is_constant()) { // Alloca and constant value is always unsafe.
-    bool found = false;
-    RiscvOperand *cur = nullptr;
-    IntRegID = 32;
-    FloatRegID = 32;
-    while (!found) {
-      if (val->type_->tid_ != Type::FloatTyID) {
-        ++IntRegID;
-        if (IntRegID > 27)
-          IntRegID = 18;
-
-        cur = getRegOperand(Register::Int, IntRegID);
-      } else {
-        ++FloatRegID;
-        if (FloatRegID > 27)
-          FloatRegID = 18;
-        cur = getRegOperand(Register::Float, FloatRegID);
+const std::vector<RiscvOperand *> &allocatableRegs(bool isFloat,
+                                                   bool crossCall) {
+  // 局部静态变量的初始化是线程安全的，四种组合一次性全部构造
+  static const auto regs = [] {
+    std::vector<std::vector<RiscvOperand *>> regs(4);
+    for (int isFloat = 0; isFloat < 2; isFloat++)
+      for (int crossCall = 0; crossCall < 2; crossCall++) {
+        auto &res = regs[isFloat * 2 + crossCall];
+        if (!crossCall) {
+          for (int i = 0; i < 8; i++)
+            res.push_back(
+                getRegOperand((isFloat ? "fa" : "a") + std::to_string(i)));
+          if (isFloat)
+            for (int i = 4; i < 12; i++)
+              res.push_back(getRegOperand("ft" + std::to_string(i)));
+        }
+        if (isFloat)
+          for (int i = 0; i < 12; i++)
+            res.push_back(getRegOperand("fs" + std::to_string(i)));
+        else
+          for (int i = 1; i < 12; i++)
+            res.push_back(getRegOperand("s" + std::to_string(i)));
+      }
+    return regs;
+  }();
+  return regs[isFloat * 2 + crossCall];
+}
+
+bool RegAlloca::isMerged(Instruction *instr) {
+  if (instr->op_id_ != Instruction::OpID::ZExt &&
+      instr->op_id_ != Instruction::OpID::BitCast)
+    return false;
+  return this->DSU_for_Variable.query(instr) ==
+         this->DSU_for_Variable.query(instr->operands_[0]);
+}
+
+bool RegAlloca::needAlloc(Value *val) {
+  if (dynamic_cast<Instruction *>(val) == nullptr &&
+      dynamic_cast<Argument *>(val) == nullptr)
+    return false;
+  if (dynamic_cast<AllocaInst *>(val) != nullptr)
+    return false;
+  return val->type_->tid_ != Type::VoidTyID;
+}
+
+void RegAlloca::computeLiveness(Function *foo) {
+  std::map<BasicBlock *, std::set<Value *>> use, def;
+  for (auto bb : foo->basic_blocks_) {
+    bb->live_in.clear();
+    bb->live_out.clear();
+    auto &curUse = use[bb], &curDef = def[bb];
+    for (auto instr : bb->instr_list_) {
+      if (isMerged(instr))
+        continue;
+      // phi 的入值在对应前驱的出口处使用
+      if (!instr->is_phi())
+        for (auto op : instr->operands_) {
+          auto val = this->DSU_for_Variable.query(op);
+          if (needAlloc(val) && !curDef.count(val))
+            curUse.insert(val);
+        }
+      auto val = this->DSU_for_Variable.query(instr);
+      if (needAlloc(val))
+        curDef.insert(val);
+    }
+  }
+  bool change = true;
+  while (change) {
+    change = false;
+    for (auto iter = foo->basic_blocks_.rbegin();
+         iter != foo->basic_blocks_.rend(); iter++) {
+      auto bb = *iter;
+      std::set<Value *> in = use[bb], out;
+      for (auto succ : bb->succ_bbs_) {
+        out.insert(succ->live_in.begin(), succ->live_in.end());
+        for (auto instr : succ->instr_list_) {
+          if (!instr->is_phi())
+            break;
+          for (int i = 1; i < instr->num_ops_; i += 2)
+            if (instr->get_operand(i) == bb) {
+              auto val = this->DSU_for_Variable.query(instr->get_operand(i - 1));
+              if (needAlloc(val))
+                out.insert(val);
+            }
+        }
       }
-      if (regFindTimeStamp.find(cur) == regFindTimeStamp.end() ||
-          safeFindTimeStamp - regFindTimeStamp[cur] > SAFE_FIND_LIMIT) {
-        setPositionReg(val, cur, bb, instr);
-        found = true;
+      for (auto val : out)
+        if (!def[bb].count(val))
+          in.insert(val);
+      if (in != bb->live_in || out != bb->live_out) {
+        bb->live_in = in;
+        bb->live_out = out;
+        change = true;
       }
     }
-  } else {
-    regFindTimeStamp[curReg[val]] = safeFindTimeStamp;
-    return curReg[val];
   }
+}
 
-  // ! Though all registers are considered unsafe, there is no way
-  // ! to writeback registers properly in findReg() for now.
-  // ! Therefore unsafe part below is not being executed for now.
-  // ! Maybe should consider using writeback() instead.
-  // For now, all registers are considered unsafe thus registers should always
-  // load from memory before using and save to memory after using.
-  auto mem_addr = findMem(val, bb, instr, 1); // Value's direct memory address
-  auto current_reg = curReg[val];             // Value's current register
-  auto load_type = val->type_;
-
-  regFindTimeStamp[current_reg] = safeFindTimeStamp; // Update time stamp
-  if (load) {
-    // Load before usage.
-    if (mem_addr != nullptr) {
-      bb->addInstrBefore(
-          new LoadRiscvInst(load_type, current_reg, mem_addr, bb), instr);
-    } else if (val->is_constant()) {
-      // If value is a int constant, create a LI instruction.
-      auto cval = dynamic_cast<ConstantInt *>(val);
-      if (cval != nullptr)
-        bb->addInstrBefore(new MoveRiscvInst(current_reg, cval->value_, bb),
-                           instr);
-      else if (dynamic_cast<ConstantFloat *>(val) != nullptr)
-        bb->addInstrBefore(
-            new MoveRiscvInst(current_reg, this->findMem(val), bb), instr);
-      else {
-        std::cerr << "[Warning] Trying to find a register for unknown type of "
-                     "constant value which is not implemented for now."
-                  << std::endl;
+// 分配时的寄存器偏好：形参与实参所在的参数寄存器、调用结果与返回值所在的 a0/fa0
+void RegAlloca::collectHints(Function *foo) {
+  hint.clear();
+  auto setHint = [&](Value *val, RiscvOperand *reg) {
+    val = this->DSU_for_Variable.query(val);
+    if (reg != nullptr && needAlloc(val) && !hint.count(val))
+      hint[val] = reg;
+  };
+  // 按调用约定返回第 i 个整型或浮点参数寄存器
+  auto argReg = [](bool isFloat, int i) -> RiscvOperand * {
+    if (i >= 8)
+      return nullptr;
+    return getRegOperand((isFloat ? "fa" : "a") + std::to_string(i));
+  };
+  int intCount = 0, floatCount = 0;
+  for (auto arg : foo->arguments_) {
+    bool isFloat = arg->type_->tid_ == Type::FloatTyID;
+    auto reg = argReg(isFloat, isFloat ? floatCount++ : intCount++);
+    if (!arg->use_list_.empty())
+      setHint(arg, reg);
+  }
+  for (auto bb : foo->basic_blocks_)
+    for (auto instr : bb->instr_list_)
+      if (instr->is_call()) {
+        int intArg = 0, floatArg = 0;
+        for (int i = 0; i + 1 < instr->num_ops_; i++) {
+          auto op = instr->get_operand(i);
+          bool isFloat = op->type_->tid_ == Type::FloatTyID;
+          setHint(op, argReg(isFloat, isFloat ? floatArg++ : intArg++));
+        }
+        setHint(instr, argReg(instr->type_->tid_ == Type::FloatTyID, 0));
+      } else if (instr->is_ret() && instr->num_ops_ > 0) {
+        auto op = instr->get_operand(0);
+        setHint(op, argReg(op->type_->tid_ == Type::FloatTyID, 0));
       }
-    } else if (isAlloca) {
-      bb->addInstrBefore(
-          new BinaryRiscvInst(
-              BinaryRiscvInst::ADDI, getRegOperand("fp"),
-              new RiscvConst(static_cast<RiscvIntPhiReg *>(pos[val])->shift_),
-              current_reg, bb),
-          instr);
-      // std::cerr << "[Debug] Get a alloca position <" << val->print() << ", "
-      //           << static_cast<RiscvIntPhiReg *>(pos[val])->print()
-      //           << "> into the register <" << current_reg->print() << ">"
-      //           << std::endl;
-    } else {
-      std::cerr << "[Error] Unknown error in findReg()." << std::endl;
-      std::terminate();
+}
+
+// 按基本块排布顺序为指令编号：每个基本块的入口占一个编号（phi 在此定义），
+// 每条指令占一个编号，出口后再留一个编号给 phi 的并行复制。
+// 指令的操作数与结果位于同一编号，因此二者不会被分配到同一寄存器；
+// phi 的入值在前驱的最后一条指令处读取，phi 在其后一个编号处写入。
+void RegAlloca::buildIntervals(Function *foo) {
+  intervals.clear();
+  related.clear();
+  std::map<Value *, int> id;
+  std::vector<int> callPos;
+  auto touch = [&](Value *val, int p) {
+    val = this->DSU_for_Variable.query(val);
+    if (!needAlloc(val))
+      return;
+    auto iter = id.find(val);
+    if (iter == id.end()) {
+      id[val] = intervals.size();
+      intervals.push_back({val, p, p, false});
+      return;
     }
+    auto &cur = intervals[iter->second];
+    cur.start = std::min(cur.start, p);
+    cur.end = std::max(cur.end, p);
+  };
+
+  // 形参在函数入口处定义
+  int p = 0;
+  for (auto arg : foo->arguments_)
+    if (!arg->use_list_.empty())
+      touch(arg, p);
+
+  for (auto bb : foo->basic_blocks_) {
+    int start = ++p;
+    for (auto val : bb->live_in)
+      touch(val, start);
+    for (auto instr : bb->instr_list_) {
+      if (instr->is_phi()) {
+        touch(instr, start);
+        continue;
+      }
+      if (isMerged(instr))
+        continue;
+      ++p;
+      for (auto op : instr->operands_)
+        touch(op, p);
+      touch(instr, p);
+      if (instr->is_call())
+        callPos.push_back(p);
+    }
+    int end = p++;
+    for (auto succ : bb->succ_bbs_) {
+      for (auto val : succ->live_in)
+        touch(val, end + 1);
+      for (auto instr : succ->instr_list_) {
+        if (!instr->is_phi())
+          break;
+        touch(instr, end + 1);
+        for (int i = 1; i < instr->num_ops_; i += 2)
+          if (instr->get_operand(i) == bb) {
+            auto val = this->DSU_for_Variable.query(instr->get_operand(i - 1));
+            auto phi = this->DSU_for_Variable.query(instr);
+            touch(val, end);
+            if (needAlloc(val) && val != phi) {
+              related[phi].push_back(val);
+              related[val].push_back(phi);
+            }
+          }
+      }
+    }
+  }
+
+  for (auto &cur : intervals) {
+    auto iter = std::upper_bound(callPos.begin(), callPos.end(), cur.start);
+    cur.crossCall = iter != callPos.end() && *iter < cur.end;
+  }
+}
+
+void RegAlloca::linearScan() {
+  curReg.clear();
+  spilled.clear();
+  std::vector<int> order(intervals.size());
+  for (int i = 0; i < order.size(); i++)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](int x, int y) {
+    return intervals[x].start < intervals[y].start;
+  });
+
+  std::vector<int> active;
+  std::set<RiscvOperand *> busy;
+  for (int cur : order) {
+    auto &it = intervals[cur];
+    for (auto iter = active.begin(); iter != active.end();)
+      if (intervals[*iter].end < it.start) {
+        busy.erase(curReg[intervals[*iter].val]);
+        iter = active.erase(iter);
+      } else
+        iter++;
+
+    // 跨越调用的区间只能使用被调用者保存的寄存器
+    bool isFloat = it.val->type_->tid_ == Type::FloatTyID;
+    auto &pool = allocatableRegs(isFloat, it.crossCall);
+    auto allowed = [&](RiscvOperand *reg) {
+      return std::find(pool.begin(), pool.end(), reg) != pool.end();
+    };
+
+    std::vector<RiscvOperand *> prefer;
+    if (hint.count(it.val))
+      prefer.push_back(hint[it.val]);
+    for (auto val : related[it.val])
+      if (curReg.count(val))
+        prefer.push_back(curReg[val]);
+    prefer.insert(prefer.end(), pool.begin(), pool.end());
+    RiscvOperand *reg = nullptr;
+    for (auto cand : prefer)
+      if (allowed(cand) && !busy.count(cand)) {
+        reg = cand;
+        break;
+      }
+
+    // 没有空闲寄存器：溢出结束位置最远的区间
+    if (reg == nullptr) {
+      auto victim = active.end();
+      for (auto iter = active.begin(); iter != active.end(); iter++)
+        if (allowed(curReg[intervals[*iter].val]) &&
+            (victim == active.end() ||
+             intervals[*iter].end > intervals[*victim].end))
+          victim = iter;
+      if (victim == active.end() || intervals[*victim].end <= it.end) {
+        spilled.push_back(it.val);
+        continue;
+      }
+      auto val = intervals[*victim].val;
+      reg = curReg[val];
+      curReg.erase(val);
+      spilled.push_back(val);
+      active.erase(victim);
+      busy.erase(reg);
+    }
+    curReg[it.val] = reg;
+    busy.insert(reg);
+    active.push_back(cur);
+    regUsed.insert(reg);
+  }
+}
+
+void RegAlloca::allocate(Function *foo, bool coloring) {
+  computeLiveness(foo);
+  collectHints(foo);
+  if (coloring)
+    GraphColoring(this).execute(foo);
+  else {
+    buildIntervals(foo);
+    linearScan();
+  }
+  addStat("regalloc.spilled-values", spilled.size());
+}
+
+RiscvOperand *RegAlloca::findReg(Value *val, RiscvBasicBlock *bb,
+                                 RiscvInstr *instr, int inReg, int load) {
+  val = this->DSU_for_Variable.query(val);
+  if (curReg.find(val) != curReg.end())
+    return curReg[val];
+  bool isFloat = val->type_->tid_ == Type::FloatTyID;
+  // 被溢出的结果先写入临时寄存器，翻译完当前指令后写回
+  if (!load) {
+    auto reg = getRegOperand(isFloat ? "ft2" : "t2");
+    for (auto &p : pendingStore)
+      if (p.first == val)
+        return reg;
+    pendingStore.push_back({val, reg});
+    return reg;
+  }
+  auto reg = getRegOperand((isFloat ? "ft" : "t") +
+                           std::to_string(scratchCount++ & 1));
+  loadValue(val, reg, bb, instr);
+  return reg;
+}
+
+void RegAlloca::loadValue(Value *val, RiscvOperand *reg, RiscvBasicBlock *bb,
+                          RiscvInstr *instr) {
+  val = this->DSU_for_Variable.query(val);
+  if (curReg.find(val) != curReg.end()) {
+    bb->addInstrBefore(new MoveRiscvInst(reg, curReg[val], bb), instr);
+    return;
+  }
+  if (auto cval = dynamic_cast<ConstantInt *>(val)) {
+    bb->addInstrBefore(new MoveRiscvInst(reg, cval->value_, bb), instr);
+    return;
+  }
+  if (dynamic_cast<AllocaInst *>(val) != nullptr) {
+    bb->addInstrBefore(
+        new BinaryRiscvInst(
+            BinaryRiscvInst::ADDI, getRegOperand("fp"),
+            new RiscvConst(static_cast<RiscvIntPhiReg *>(pos[val])->shift_),
+            reg, bb),
+        instr);
+    return;
+  }
+  if (dynamic_cast<GlobalVariable *>(val) != nullptr) {
+    bb->addInstrBefore(new LoadAddressRiscvInstr(reg, val->name_, bb), instr);
+    return;
+  }
+  // 浮点常量与被溢出的变量从内存中载入
+  auto mem = dynamic_cast<ConstantFloat *>(val) != nullptr
+                 ? findMem(val, bb, instr, false)
+                 : findMem(val);
+  if (mem == nullptr) {
+    std::cerr << "[Fatal Error] Value " << val->name_
+              << " has neither register nor memory position." << std::endl;
+    std::terminate();
+  }
+  Type *ty = reg->getType() == RiscvOperand::FloatReg
+                 ? new Type(Type::FloatTyID)
+                 : new Type(val->type_->tid_ == Type::PointerTyID
+                                ? Type::PointerTyID
+                                : Type::IntegerTyID);
+  bb->addInstrBefore(new LoadRiscvInst(ty, reg, mem, bb), instr);
+}
+
+void RegAlloca::storeValue(Value *val, RiscvOperand *reg, RiscvBasicBlock *bb) {
+  val = this->DSU_for_Variable.query(val);
+  if (curReg.find(val) != curReg.end()) {
+    bb->addInstrBack(new MoveRiscvInst(curReg[val], reg, bb));
+    return;
+  }
+  auto mem = findMem(val);
+  if (mem != nullptr)
+    bb->addInstrBack(new StoreRiscvInst(val->type_, reg, mem, bb));
+}
+
+RiscvOperand *RegAlloca::getLocation(Value *val) {
+  val = this->DSU_for_Variable.query(val);
+  if (curReg.find(val) != curReg.end())
+    return curReg[val];
+  if (needAlloc(val))
+    return findMem(val);
+  return nullptr;
+}
+
+void RegAlloca::emitCopy(RiscvOperand *dest, RiscvOperand *src, Type *ty,
+                         RiscvBasicBlock *bb) {
+  auto memType = [&](RiscvOperand *reg) {
+    if (reg->getType() == RiscvOperand::FloatReg)
+      return new Type(Type::FloatTyID);
+    return new Type(ty->tid_ == Type::PointerTyID ? Type::PointerTyID
+                                                  : Type::IntegerTyID);
+  };
+  if (dest->isRegister() && src->isRegister())
+    bb->addInstrBack(new MoveRiscvInst(dest, src, bb));
+  else if (dest->isRegister())
+    bb->addInstrBack(new LoadRiscvInst(memType(dest), dest, src, bb));
+  else if (src->isRegister())
+    bb->addInstrBack(new StoreRiscvInst(memType(src), src, dest, bb));
+  else {
+    // 栈位之间按位复制
+    auto tmp = getRegOperand("t4");
+    bb->addInstrBack(new LoadRiscvInst(memType(tmp), tmp, src, bb));
+    bb->addInstrBack(new StoreRiscvInst(memType(tmp), tmp, dest, bb));
   }
+}
 
-  return current_reg;
+void RegAlloca::parallelCopy(std::vector<CopyPair> copies,
+                             RiscvBasicBlock *bb) {
+  std::vector<CopyPair> pending, materialize;
+  for (auto &copy : copies) {
+    if (copy.src == nullptr)
+      copy.src = getLocation(copy.val);
+    if (copy.src == nullptr)
+      materialize.push_back(copy);
+    else if (copy.src != copy.dest)
+      pending.push_back(copy);
+  }
+  while (!pending.empty()) {
+    bool progress = false;
+    for (int i = 0; i < pending.size();) {
+      bool blocked = false;
+      for (int j = 0; j < pending.size() && !blocked; j++)
+        blocked = j != i && pending[j].src == pending[i].dest;
+      if (blocked) {
+        i++;
+        continue;
+      }
+      emitCopy(pending[i].dest, pending[i].src, pending[i].val->type_, bb);
+      pending.erase(pending.begin() + i);
+      progress = true;
+    }
+    if (progress)
+      continue;
+    // 剩余的复制均处于环中：将一个目标的原值移入临时寄存器
+    auto dest = pending.front().dest;
+    auto ty = pending.front().val->type_;
+    auto tmp = getRegOperand(ty->tid_ == Type::FloatTyID ? "ft3" : "t3");
+    emitCopy(tmp, dest, ty, bb);
+    for (auto &copy : pending)
+      if (copy.src == dest)
+        copy.src = tmp;
+  }
+  // 常量与地址不会被其他复制覆盖，最后生成
+  for (auto &copy : materialize) {
+    if (copy.dest->isRegister()) {
+      loadValue(copy.val, copy.dest, bb);
+      continue;
+    }
+    auto tmp = getRegOperand("t4");
+    loadValue(copy.val, tmp, bb);
+    emitCopy(copy.dest, tmp, copy.val->type_, bb);
+  }
 }
 
 RiscvOperand *RegAlloca::findMem(Value *val, RiscvBasicBlock *bb,
                                  RiscvInstr *instr, bool direct) {
   val = this->DSU_for_Variable.query(val);
-  if (pos.count(val) == 0 && !val->is_constant()) {
-    std::cerr << "[Warning] Value " << std::hex << val << " (" << val->name_
-              << ")'s memory map not found." << std::endl;
-  }
   bool isGVar = dynamic_cast<GlobalVariable *>(val) != nullptr;
-  bool isPointer = val->type_->tid_ == val->type_->PointerTyID;
   bool isAlloca = dynamic_cast<AllocaInst *>(val) != nullptr;
   // All float constant considered as global variables for now.
   isGVar = isGVar || dynamic_cast<ConstantFloat *>(val) != nullptr;
@@ -172,87 +531,35 @@ RiscvOperand *RegAlloca::findMem(Value *val, RiscvBasicBlock *bb,
         instr);
     return new RiscvIntPhiReg("t5");
   }
-  // If not loading pointer's address directly, then use indirect addressing.
-  // Ignore alloca due to the instruction only being dealt by findReg()
-  if (isPointer && !isAlloca && !direct) {
-    if (bb == nullptr) {
-      std::cerr << "[Warning] Trying to add indirect pointer addressing "
-                   "instruction, but basic block pointer is null."
-                << std::endl;
-      return nullptr;
-    }
-
-    bb->addInstrBefore(new LoadRiscvInst(new Type(Type::PointerTyID),
-                                         getRegOperand("t4"), pos[val], bb),
-                       instr);
-    return new RiscvIntPhiReg("t4");
-  }
-  // Cannot access to alloca's memory directly.
-  else if (direct && isAlloca)
+  if (direct || isAlloca)
+    return findMem(val);
+  // 间接寻址：指针位于寄存器中，或被溢出到栈上
+  if (curReg.find(val) != curReg.end())
+    return new RiscvIntPhiReg(static_cast<RiscvIntReg *>(curReg[val])->reg_);
+  if (bb == nullptr) {
+    std::cerr << "[Warning] Trying to add indirect pointer addressing "
+                 "instruction, but basic block pointer is null."
+              << std::endl;
     return nullptr;
+  }
+  bb->addInstrBefore(new LoadRiscvInst(new Type(Type::PointerTyID),
+                                       getRegOperand("t4"), findMem(val), bb),
+                     instr);
+  return new RiscvIntPhiReg("t4");
+}
 
+RiscvOperand *RegAlloca::findMem(Value *val) {
+  val = this->DSU_for_Variable.query(val);
   if (pos.find(val) == pos.end())
     return nullptr;
-
   return pos[val];
 }
 
-RiscvOperand *RegAlloca::findMem(Value *val) {
-  return findMem(val, nullptr, nullptr, true);
-}
-
-RiscvOperand *RegAlloca::findNonuse(Type *ty, RiscvBasicBlock *bb,
-                                    RiscvInstr *instr) {
-  if (ty->tid_ == Type::IntegerTyID || ty->tid_ == Type::PointerTyID) {
-    ++IntRegID;
-    if (IntRegID > 27)
-      IntRegID = 18;
-    return getRegOperand(Register::Int, IntRegID);
-  } else {
-    ++FloatRegID;
-    if (FloatRegID > 27)
-      FloatRegID = 18;
-    return getRegOperand(Register::Float, FloatRegID);
-  }
-}
-
 void RegAlloca::setPosition(Value *val, RiscvOperand *riscvVal) {
   val = this->DSU_for_Variable.query(val);
-  if (pos.find(val) != pos.end()) {
-    // std::cerr << "[Warning] Trying overwriting memory address map of value "
-    //           << std::hex << val << " (" << val->name_ << ") ["
-    //           << riscvVal->print() << " -> " << pos[val]->print() << "]"
-    //           << std::endl;
-    // std::terminate();
-  }
-
-  // std::cerr << "[Debug] [RegAlloca] Map value <" << val->print()
-  //           << "> to operand <" << riscvVal->print() << ">" << std::endl;
-
   pos[val] = riscvVal;
 }
 
-RiscvOperand *RegAlloca::findSpecificReg(Value *val, std::string RegName,
-                                         RiscvBasicBlock *bb, RiscvInstr *instr,
-                                         bool direct) {
-  val = this->DSU_for_Variable.query(val);
-  RiscvOperand *retOperand = getRegOperand(RegName);
-
-  return findReg(val, bb, instr, 0, 1, retOperand, direct);
-}
-
-void RegAlloca::setPositionReg(Value *val, RiscvOperand *riscvReg,
-                               RiscvBasicBlock *bb, RiscvInstr *instr) {
-  val = this->DSU_for_Variable.query(val);
-  Value *old_val = getRegPosition(riscvReg);
-  RiscvOperand *old_reg = getPositionReg(val);
-  if (old_val != nullptr && old_val != val)
-    writeback(riscvReg, bb, instr);
-  if (old_reg != nullptr && old_reg != riscvReg)
-    writeback(old_reg, bb, instr);
-  setPositionReg(val, riscvReg);
-}
-
 void RegAlloca::setPositionReg(Value *val, RiscvOperand *riscvReg) {
   val = this->DSU_for_Variable.query(val);
   if (riscvReg->isRegister() == false) {
@@ -260,60 +567,11 @@ void RegAlloca::setPositionReg(Value *val, RiscvOperand *riscvReg) {
               << " to not a register operand." << std::endl;
     std::terminate();
   }
-
-  // std::cerr << "[Debug] Map register <" << riscvReg->print() << "> to value <"
-  //           << val->print() << ">\n";
-
   curReg[val] = riscvReg;
-  regPos[riscvReg] = val;
   regUsed.insert(riscvReg);
 }
 
-RiscvInstr *RegAlloca::writeback(RiscvOperand *riscvReg, RiscvBasicBlock *bb,
-                                 RiscvInstr *instr) {
-  Value *value = getRegPosition(riscvReg);
-  if (value == nullptr)
-    return nullptr; // Value not found in map
-
-  value = this->DSU_for_Variable.query(value);
-
-  // std::cerr << "[Debug] [RegAlloca] Writeback register <" << riscvReg->print()
-  //           << "> to value <" << value->print() << ">.\n";
-
-  // Erase map info
-  regPos.erase(riscvReg);
-  regFindTimeStamp.erase(riscvReg);
-  curReg.erase(value);
-
-  RiscvOperand *mem_addr = findMem(value);
-
-  if (mem_addr == nullptr) {
-    // std::cerr << "[Debug] [RegAlloca] Writeback ignore alloca pointer direct "
-    //              "access and immvalue.\n";
-    return nullptr; // Maybe an immediate value or dicrect accessing alloca
-  }
-
-  auto store_type = value->type_;
-  auto store_instr = new StoreRiscvInst(value->type_, riscvReg, mem_addr, bb);
-
-  // Write store instruction
-  if (instr != nullptr)
-    bb->addInstrBefore(store_instr, instr);
-  else
-    bb->addInstrBack(store_instr);
-
-  return store_instr;
-}
-
 RegAlloca::RegAlloca() {
-  // 初始化寄存器对象池。
-  if (regPool.size() == 0) {
-    for (int i = 0; i < 32; i++)
-      regPool.push_back(new RiscvIntReg(new Register(Register::Int, i)));
-    for (int i = 0; i < 32; i++)
-      regPool.push_back(new RiscvFloatReg(new Register(Register::Float, i)));
-  }
-
   // fp 的保护单独进行处理
   regUsed.insert(getRegOperand("ra"));
   savedRegister.push_back(getRegOperand("ra")); // 保护 ra
@@ -325,18 +583,6 @@ RegAlloca::RegAlloca() {
     savedRegister.push_back(getRegOperand("fs" + std::to_string(i)));
 }
 
-RiscvInstr *RegAlloca::writeback(Value *val, RiscvBasicBlock *bb,
-                                 RiscvInstr *instr) {
-  auto reg = getPositionReg(val);
-  return writeback(reg, bb, instr);
-}
-
-Value *RegAlloca::getRegPosition(RiscvOperand *reg) {
-  if (regPos.find(reg) == regPos.end())
-    return nullptr;
-  return this->DSU_for_Variable.query(regPos[reg]);
-}
-
 RiscvOperand *RegAlloca::getPositionReg(Value *val) {
   val = this->DSU_for_Variable.query(val);
   if (curReg.find(val) == curReg.end())
@@ -356,25 +602,410 @@ RiscvOperand *RegAlloca::findPtr(Value *val, RiscvBasicBlock *bb,
 }
 
 void RegAlloca::writeback_all(RiscvBasicBlock *bb, RiscvInstr *instr) {
-  std::vector<RiscvOperand *> regs_to_writeback;
-  for (auto p : regPos)
-    regs_to_writeback.push_back(p.first);
-  for (auto r : regs_to_writeback)
-    writeback(r, bb, instr);
+  for (auto &p : pendingStore) {
+    auto mem_addr = findMem(p.first);
+    // 没有被使用的结果没有栈位，直接丢弃
+    if (mem_addr != nullptr)
+      bb->addInstrBefore(new StoreRiscvInst(p.first->type_, p.second, mem_addr, bb),
+                         instr);
+  }
+  pendingStore.clear();
+  scratchCount = 0;
 }
 
 void RegAlloca::setPointerPos(Value *val, RiscvOperand *PointerMem) {
   val = this->DSU_for_Variable.query(val);
   assert(val->type_->tid_ == Type::TypeID::PointerTyID ||
          val->type_->tid_ == Type::TypeID::ArrayTyID);
-  // std::cerr << "SET POINTER: " << val->name_ << "!" << PointerMem->print()
-  //           << "\n";
   this->ptrPos[val] = PointerMem;
 }
 
 void RegAlloca::clear() {
-  curReg.clear();
-  regPos.clear();
-  safeFindTimeStamp = 0;
-  regFindTimeStamp.clear();
+  pendingStore.clear();
+  scratchCount = 0;
+}
+int GraphColoring::getNode(Value *val) {
+  val = regAlloca->DSU_for_Variable.query(val);
+  if (!regAlloca->needAlloc(val))
+    return -1;
+  auto iter = id.find(val);
+  if (iter != id.end())
+    return iter->second;
+  int n = node.size();
+  id[val] = n;
+  node.push_back(val);
+  adjList.emplace_back();
+  degree.push_back(0);
+  alias.push_back(n);
+  state.push_back(Simplify);
+  crossCall.push_back(false);
+  cost.push_back(0);
+  color.push_back(nullptr);
+  hint.push_back(regAlloca->hint.count(val) ? regAlloca->hint[val] : nullptr);
+  moveList.emplace_back();
+  return n;
+}
+
+void GraphColoring::addEdge(int u, int v) {
+  if (u == v || adjList[u].count(v))
+    return;
+  // 整型与浮点寄存器互不干扰
+  if ((node[u]->type_->tid_ == Type::FloatTyID) !=
+      (node[v]->type_->tid_ == Type::FloatTyID))
+    return;
+  adjList[u].insert(v);
+  adjList[v].insert(u);
+  degree[u]++;
+  degree[v]++;
+}
+
+// 冲突图与线性扫描的编号方式一致：指令的结果与其操作数互相冲突；
+// 同一基本块的 phi 在入口处同时定义，与入口处活跃的变量互相冲突；
+// phi 与其入值之间不产生冲突，作为传送指令参与合并。
+// 循环深度取自 LoopInfo，由调用者在生成代码前计算
+void GraphColoring::build(Function *foo) {
+  auto weight = [&](BasicBlock *bb) {
+    double w = 1;
+    for (int i = 0; i < bb->loop_depth_; i++)
+      w *= 10;
+    return w;
+  };
+
+  // 结点按形参与指令的顺序编号，使分配结果不依赖于 live_in、live_out
+  // 中按地址排列的遍历顺序
+  for (auto arg : foo->arguments_)
+    if (!arg->use_list_.empty())
+      getNode(arg);
+  for (auto bb : foo->basic_blocks_)
+    for (auto instr : bb->instr_list_)
+      getNode(instr);
+
+  // 形参在函数入口处同时定义
+  auto entry = foo->basic_blocks_.front();
+  for (auto arg : foo->arguments_) {
+    if (arg->use_list_.empty())
+      continue;
+    int a = getNode(arg);
+    cost[a] += 1;
+    for (auto val : entry->live_in)
+      addEdge(a, getNode(val));
+  }
+
+  for (auto bb : foo->basic_blocks_) {
+    double w = weight(bb);
+    std::set<int> live;
+    for (auto val : bb->live_out)
+      live.insert(getNode(val));
+    for (auto iter = bb->instr_list_.rbegin(); iter != bb->instr_list_.rend();
+         iter++) {
+      auto instr = *iter;
+      if (instr->is_phi())
+        break;
+      if (regAlloca->isMerged(instr))
+        continue;
+      int d = getNode(instr);
+      if (instr->is_call())
+        for (auto l : live)
+          if (l != d)
+            crossCall[l] = true;
+      if (d >= 0) {
+        for (auto l : live)
+          addEdge(d, l);
+        live.erase(d);
+        cost[d] += w;
+      }
+      for (auto op : instr->operands_) {
+        int o = getNode(op);
+        if (o < 0)
+          continue;
+        cost[o] += w;
+        if (d >= 0)
+          addEdge(d, o);
+        live.insert(o);
+      }
+    }
+    std::vector<int> phis;
+    for (auto instr : bb->instr_list_) {
+      if (!instr->is_phi())
+        break;
+      int p = getNode(instr);
+      phis.push_back(p);
+      cost[p] += w;
+      for (int i = 0; i < instr->num_ops_; i += 2) {
+        int o = getNode(instr->get_operand(i));
+        if (o < 0)
+          continue;
+        cost[o] += weight(static_cast<BasicBlock *>(instr->get_operand(i + 1)));
+        if (o != p) {
+          moveList[p].push_back(moves.size());
+          moveList[o].push_back(moves.size());
+          worklistMoves.insert(moves.size());
+          moves.push_back({p, o});
+          moveState.push_back(WorklistMove);
+        }
+      }
+    }
+    for (auto p : phis) {
+      for (auto l : live)
+        addEdge(p, l);
+      for (auto q : phis)
+        addEdge(p, q);
+    }
+  }
+}
+
+const std::vector<RiscvOperand *> &GraphColoring::colorsOf(int n) {
+  return allocatableRegs(node[n]->type_->tid_ == Type::FloatTyID, crossCall[n]);
+}
+
+std::vector<int> GraphColoring::adjacent(int n) {
+  std::vector<int> res;
+  for (auto m : adjList[n])
+    if (state[m] != Select && state[m] != Coalesced)
+      res.push_back(m);
+  return res;
+}
+
+std::vector<int> GraphColoring::nodeMoves(int n) {
+  std::vector<int> res;
+  for (auto m : moveList[n])
+    if (moveState[m] == ActiveMove || moveState[m] == WorklistMove)
+      res.push_back(m);
+  return res;
+}
+
+void GraphColoring::makeWorklist() {
+  for (int n = 0; n < node.size(); n++)
+    if (degree[n] >= K(n)) {
+      state[n] = Spill;
+      spillWorklist.insert(n);
+    } else if (moveRelated(n)) {
+      state[n] = Freeze;
+      freezeWorklist.insert(n);
+    } else {
+      state[n] = Simplify;
+      simplifyWorklist.insert(n);
+    }
+}
+
+void GraphColoring::simplify() {
+  int n = *simplifyWorklist.begin();
+  simplifyWorklist.erase(n);
+  state[n] = Select;
+  selectStack.push_back(n);
+  for (auto m : adjacent(n))
+    decrementDegree(m);
+}
+
+void GraphColoring::decrementDegree(int m) {
+  if (degree[m]-- != K(m))
+    return;
+  enableMoves(m);
+  for (auto n : adjacent(m))
+    enableMoves(n);
+  if (state[m] != Spill)
+    return;
+  spillWorklist.erase(m);
+  if (moveRelated(m)) {
+    state[m] = Freeze;
+    freezeWorklist.insert(m);
+  } else {
+    state[m] = Simplify;
+    simplifyWorklist.insert(m);
+  }
+}
+
+void GraphColoring::enableMoves(int n) {
+  for (auto m : nodeMoves(n))
+    if (moveState[m] == ActiveMove) {
+      moveState[m] = WorklistMove;
+      worklistMoves.insert(m);
+    }
+}
+
+void GraphColoring::addWorklist(int u) {
+  if (state[u] == Freeze && !moveRelated(u) && degree[u] < K(u)) {
+    freezeWorklist.erase(u);
+    state[u] = Simplify;
+    simplifyWorklist.insert(u);
+  }
+}
+
+// George 准则：v 的每个邻居要么度数较小，要么已与 u 冲突（要求合并后可用颜色不减少）；
+// Briggs 准则：合并后度数不小于其颜色数的邻居少于合并后结点的颜色数。
+bool GraphColoring::conservative(int u, int v) {
+  if (K(v) >= K(u)) {
+    bool george = true;
+    for (auto t : adjacent(v))
+      if (degree[t] >= K(t) && !adjList[t].count(u)) {
+        george = false;
+        break;
+      }
+    if (george)
+      return true;
+  }
+  std::set<int> nodes;
+  for (auto t : adjacent(u))
+    nodes.insert(t);
+  for (auto t : adjacent(v))
+    nodes.insert(t);
+  int k = 0;
+  for (auto t : nodes)
+    if (degree[t] >= K(t))
+      k++;
+  return k < std::min(K(u), K(v));
+}
+
+int GraphColoring::getAlias(int n) {
+  return state[n] == Coalesced ? alias[n] = getAlias(alias[n]) : n;
+}
+
+void GraphColoring::coalesce() {
+  int m = *worklistMoves.begin();
+  worklistMoves.erase(m);
+  int u = getAlias(moves[m].first), v = getAlias(moves[m].second);
+  // 形参总是作为合并后的代表，使经栈传入的形参仍能使用其传入位置
+  if (dynamic_cast<Argument *>(node[v]) != nullptr)
+    std::swap(u, v);
+  if (u == v) {
+    moveState[m] = CoalescedMove;
+    addWorklist(u);
+  } else if (adjList[u].count(v)) {
+    moveState[m] = ConstrainedMove;
+    addWorklist(u);
+    addWorklist(v);
+  } else if (conservative(u, v)) {
+    moveState[m] = CoalescedMove;
+    combine(u, v);
+    addWorklist(u);
+  } else
+    moveState[m] = ActiveMove;
+}
+
+void GraphColoring::combine(int u, int v) {
+  if (state[v] == Freeze)
+    freezeWorklist.erase(v);
+  else
+    spillWorklist.erase(v);
+  state[v] = Coalesced;
+  alias[v] = u;
+  moveList[u].insert(moveList[u].end(), moveList[v].begin(), moveList[v].end());
+  crossCall[u] = crossCall[u] || crossCall[v];
+  cost[u] += cost[v];
+  if (hint[u] == nullptr)
+    hint[u] = hint[v];
+  enableMoves(v);
+  for (auto t : adjacent(v)) {
+    addEdge(t, u);
+    decrementDegree(t);
+  }
+  if (degree[u] >= K(u) && state[u] == Freeze) {
+    freezeWorklist.erase(u);
+    state[u] = Spill;
+    spillWorklist.insert(u);
+  }
+}
+
+void GraphColoring::freeze() {
+  int u = *freezeWorklist.begin();
+  freezeWorklist.erase(u);
+  state[u] = Simplify;
+  simplifyWorklist.insert(u);
+  freezeMoves(u);
+}
+
+void GraphColoring::freezeMoves(int u) {
+  for (auto m : nodeMoves(u)) {
+    int x = moves[m].first, y = moves[m].second;
+    int v = getAlias(y) == getAlias(u) ? getAlias(x) : getAlias(y);
+    if (moveState[m] == WorklistMove)
+      worklistMoves.erase(m);
+    moveState[m] = FrozenMove;
+    if (state[v] == Freeze && !moveRelated(v) && degree[v] < K(v)) {
+      freezeWorklist.erase(v);
+      state[v] = Simplify;
+      simplifyWorklist.insert(v);
+    }
+  }
+}
+
+// 选择代价与度数之比最小的结点作为潜在溢出
+void GraphColoring::selectSpill() {
+  int m = -1;
+  for (auto n : spillWorklist)
+    if (m < 0 || cost[n] * degree[m] < cost[m] * degree[n])
+      m = n;
+  spillWorklist.erase(m);
+  state[m] = Simplify;
+  simplifyWorklist.insert(m);
+  freezeMoves(m);
+}
+
+// 着色时依次偏好：参数寄存器等提示、传送指令另一端的颜色、调用者保存的寄存器
+void GraphColoring::assignColors() {
+  while (!selectStack.empty()) {
+    int n = selectStack.back();
+    selectStack.pop_back();
+    std::set<RiscvOperand *> forbidden;
+    for (auto w : adjList[n]) {
+      int a = getAlias(w);
+      if (state[a] == Colored)
+        forbidden.insert(color[a]);
+    }
+    std::vector<RiscvOperand *> prefer;
+    if (hint[n] != nullptr)
+      prefer.push_back(hint[n]);
+    for (auto m : moveList[n]) {
+      int a = getAlias(moves[m].first) == n ? getAlias(moves[m].second)
+                                            : getAlias(moves[m].first);
+      if (state[a] == Colored)
+        prefer.push_back(color[a]);
+    }
+    auto &pool = colorsOf(n);
+    prefer.insert(prefer.end(), pool.begin(), pool.end());
+    state[n] = Spilled;
+    for (auto reg : prefer)
+      if (!forbidden.count(reg) &&
+          std::find(pool.begin(), pool.end(), reg) != pool.end()) {
+        state[n] = Colored;
+        color[n] = reg;
+        break;
+      }
+  }
+}
+
+// 被合并的变量通过并查集合并到其代表上，共用同一个寄存器或栈位
+void GraphColoring::apply() {
+  auto &DSU = regAlloca->DSU_for_Variable;
+  for (int n = 0; n < node.size(); n++) {
+    int a = getAlias(n);
+    if (a != n)
+      DSU.merge(node[n], node[a]);
+    else if (state[n] == Spilled)
+      regAlloca->spilled.push_back(node[n]);
+    else {
+      regAlloca->curReg[node[n]] = color[n];
+      regAlloca->regUsed.insert(color[n]);
+    }
+  }
+}
+
+void GraphColoring::execute(Function *foo) {
+  regAlloca->curReg.clear();
+  regAlloca->spilled.clear();
+  build(foo);
+  makeWorklist();
+  while (!simplifyWorklist.empty() || !worklistMoves.empty() ||
+         !freezeWorklist.empty() || !spillWorklist.empty()) {
+    if (!simplifyWorklist.empty())
+      simplify();
+    else if (!worklistMoves.empty())
+      coalesce();
+    else if (!freezeWorklist.empty())
+      freeze();
+    else
+      selectSpill();
+  }
+  assignColors();
+  apply();
 }
\ No newline at end of file
@@ -44,30 +44,20 @@ public:
   }
 };
 
-// 关于额外发射指令问题说明
-// 举例：如果当前需要使用特定寄存器（以a0为例）以存取返回值
-// 1. 如果当前变量在内存：a)
-// a)
-// 由regalloca发射一个sw指令（使用rbb中addInstrback函数）将现在的a0送回对应内存或栈上地址
-// b) 由regalloca发射一个lw指令（使用rbb中addInstrback函数）将该变量移入a0中
-// 2. 如果该变量在寄存器x中：
-// a)
-// 由regalloca发射一个sw指令（使用rbb中addInstrback函数）将现在的a0送回对应内存或栈上地址
-// b) 由regalloca发射一个mv指令（使用rbb中addInstrback函数）将该变量从x移入a0中
-
-// 举例：为当前一个未指定寄存器，或当前寄存器堆中没有存放该变量的寄存器。现在需要为该变量找一个寄存器以进行运算
-// 存在空寄存器：找一个空闲未分配寄存器，然后返回一个寄存器指针riscvOperand*
-// 不存在空寄存器：
-// a) 找一个寄存器
-// b)
-// 由regalloca发射一个sw指令（使用rbb中addInstrback函数）将现在该寄存器的数字送回对应内存或栈上地址
-// c) 返回该寄存器指针riscvOperand*
-
-// 注意区分指针类型（如*a0）和算数值（a0）的区别
-
-// 每个变量会有一个固定的内存或栈地址，可能会被分配一个固定寄存器地址
-
-extern int IntRegID, FloatRegID; // 测试阶段使用
+// 寄存器分配说明
+// 在翻译一个函数之前，先在 IR 上计算各基本块的活跃变量（live_in / live_out），
+// 再按基本块的排布顺序为每条指令编号，得到每个变量的单段活跃区间 [start, end]。
+// 随后对活跃区间进行线性扫描分配：
+// 1. 跨越函数调用的区间只使用被调用者保存的寄存器 s1-s11、fs0-fs11；
+// 2. 其余区间优先使用调用者保存的寄存器 a0-a7、fa0-fa7、ft4-ft11，无需保护现场；
+// 3. 寄存器不足时溢出结束位置最远的区间，被溢出的变量在整个函数内都位于栈上。
+// 翻译时 findReg 直接返回变量所分配的寄存器；对被溢出的变量、常量、alloca
+// 地址与全局变量地址，则在临时寄存器中载入或计算，结果写回栈上。
+// 在 -O2 下改用迭代合并的图着色分配（见 GraphColoring），二者共用上述翻译方式。
+// 以下寄存器不参与分配，作为翻译时的临时寄存器使用：
+// t0-t1、ft0-ft1: 操作数载入     t2、ft2: 被溢出的结果
+// t3、ft3: 乘法偏移量与并行复制中的环     t4: 间接寻址与栈位间复制
+// t5: 全局地址     t6: 溢出的立即数偏移量
 
 Register *NamefindReg(std::string reg);
 
@@ -75,45 +65,71 @@ Register *NamefindReg(std::string reg);
 // 根据寄存器 riscvReg 的类型返回存储指令的类型
 Type *getStoreTypeFromRegType(RiscvOperand *riscvReg);
 
+// 活跃区间：线性化后指令编号上的单段区间，端点均为闭区间
+struct LiveInterval {
+  Value *val;
+  int start, end;
+  bool crossCall; // 区间内部是否存在函数调用
+};
+
+// 并行复制中的一项：将 val（位于 src，为空时按 val 所在位置读取）复制到 dest
+struct CopyPair {
+  RiscvOperand *dest;
+  Value *val;
+  RiscvOperand *src;
+};
+
 // RegAlloca类被放置在**每个函数**内，每个函数内是一个新的寄存器分配类。
 // 因而约定x8-x9 x18-27、f8-9、f18-27
 // 是约定的所有函数都要保护的寄存器，用完要恢复原值
-// 其他的寄存器（除函数参数所用的a0-a7等寄存器）都视为是不安全的，可能会在之后的运算中发生变化
-// TODO:3
-// 在该类的实例生存周期内，使用到的需要保护的寄存器使用一个vector<Register*>
-// 存储
+// 其他的寄存器（除函数参数所用的a0-a7等寄存器）都视为是不安全的，会在函数调用中发生变化
 
 // 寄存器分配（IR变量到汇编变量地址映射）
-// 所有的临时变量均分配在栈上（从当前函数开始的地方开始计算栈地址，相对栈偏移地址），所有的全局变量放置在内存中（首地址+偏移量形式）
-// 当存在需要寄存器保护的时候，直接找回原地址去进行
+// 被溢出的变量分配在栈上（相对 fp 的偏移地址），所有的全局变量放置在内存中（首地址+偏移量形式）
 class RegAlloca {
 public:
   DSU<Value *> DSU_for_Variable;
 
   /**
-   * 返回 Value 所关联的寄存器操作数。若 Value
-   * 未关联寄存器，则分配寄存器并进行关联，并处理相关的数据载入与写回。
+   * 计算活跃变量，并通过线性扫描或图着色为函数内的变量分配寄存器。
+   * 被溢出的变量记录在 spilled 中，其栈位由调用者通过 setPosition 指定。
+   * @param foo 需要分配寄存器的函数
+   * @param coloring 为真时使用图着色分配，否则使用线性扫描
+   */
+  void allocate(Function *foo, bool coloring = false);
+
+  /**
+   * 计算各基本块的 live_in 与 live_out 。phi 的入值视为在对应前驱的出口处活跃。
+   */
+  void computeLiveness(Function *foo);
+
+  /**
+   * 判断（并查集代表的）变量是否需要寄存器或栈位。常量、全局变量与 alloca
+   * 的地址在使用时临时生成，不需要分配。
+   */
+  bool needAlloc(Value *val);
+
+  /**
+   * 判断 zext 与 bitcast 是否已通过并查集与其操作数合并，合并后无需生成指令。
+   */
+  bool isMerged(Instruction *instr);
+
+  /**
+   * 返回 Value 所关联的寄存器操作数。
    * @param val 需要查找寄存器的 Value
    * @param bb 插入指令需要提供的基本块
    * @param instr 在 instr 之前插入指令（可选）
-   * @param inReg 是否一定返回一个寄存器操作数，若为 true 则是
-   * @param load 是否将 Value 所对应的物理地址内容载入到寄存器中，若为 true 则是
-   * @param specified 是否指定关联的寄存器，若为 nullptr
-   * 则不指定，若为一个寄存器操作数则在任何情况下都将 Value
-   * 与指定的寄存器进行强制关联。
-   * @param direct 仅在 Value 为指针时生效，用于在载入物理地址时传递参数给
-   * findMem
+   * @param inReg 保留参数，findReg 总是返回寄存器操作数
+   * @param load 是否将 Value 的值载入到寄存器中。为 1 时 Value 作为操作数被读取；
+   * 为 0 时 Value 作为结果被写入，若 Value 被溢出则返回临时寄存器，并在
+   * writeback_all 时写回栈上。
    * @return 返回一个 IntegerReg* 或 FloatReg* 类型的操作数 rs 。
-   * @attention 该函数将在 Value 为 Alloca 指令时进行特殊处理，在 load=1 时将
-   * Alloca 指针所指向的地址载入到分配的寄存器中。
-   * @attention 该函数将在 Value 为常量时进行特殊处理，在 load=1 时将常量通过 LI
-   * 指令载入到分配的寄存器中。
-   * @attention 目前不应使用 direct 参数。
+   * @attention 对 Alloca 指令将计算其所指向的地址；对常量将通过 LI
+   * 指令（浮点常量通过内存）载入。
    */
   RiscvOperand *findReg(Value *val, RiscvBasicBlock *bb,
                         RiscvInstr *instr = nullptr, int inReg = 0,
-                        int load = 1, RiscvOperand *specified = nullptr,
-                        bool direct = true);
+                        int load = 1);
 
   /**
    * 对传递过来的 Value 返回其所处的物理地址操作数 offset(rs) 。
@@ -121,10 +137,10 @@ public:
    * @param bb 插入指令需要提供的基本块
    * @param instr 在 instr 之前插入指令（可选）
    * @param direct 当 direct 为 false 时将使用间接寻址。若使用间接寻址且
-   * Value 为指针 (getElementInstr) ，则 findMem()
-   * 将会将指针所指向的地址载入临时寄存器 t5，并返回操作数 0(t5) 。
-   * @return 返回一个 IntegerPhiReg* 或 FloatPhiReg* 类型的操作数 offset(rs)
-   * 。若操作数偏移量溢出，则将会计算返回操作数所指代的地址 (t5)。
+   * Value 为指针，则返回指针所指向的地址：指针位于寄存器 rs 时返回 0(rs)，
+   * 被溢出时载入临时寄存器 t4 并返回 0(t4) 。
+   * @return 返回一个 IntegerPhiReg* 或 FloatPhiReg* 类型的操作数 offset(rs) 。
+   * 全局变量与浮点常量的地址将载入 t5 并返回 (t5) 。
    */
   RiscvOperand *findMem(Value *val, RiscvBasicBlock *bb, RiscvInstr *instr,
                         bool direct);
@@ -135,30 +151,27 @@ public:
    */
   RiscvOperand *findMem(Value *val);
 
-  // TODO:2 findNonuse
-  // 实现一个函数，以找到一个当前尚未使用的寄存器以存放某个值。
-  RiscvOperand *findNonuse(Type *ty, RiscvBasicBlock *bb,
-                           RiscvInstr *instr = nullptr);
+  /**
+   * 将 Value 的值载入（或计算）到指定的寄存器 reg 中。
+   */
+  void loadValue(Value *val, RiscvOperand *reg, RiscvBasicBlock *bb,
+                 RiscvInstr *instr = nullptr);
 
   /**
-   * 将 Value 与指定的寄存器强制关联并返回寄存器操作数。
-   * @param val 需要查找寄存器的 Value
-   * @param RegName 需要强制关联的寄存器接口名称
-   * @param bb 插入指令需要提供的基本块
-   * @param instr 在 instr 之前插入指令（可选）
-   * @param direct 仅在 Value 为指针时生效，用于在载入物理地址时传递参数给
-   * findMem
-   * @return 返回强制关联的寄存器操作数 rs 。
-   * @note 该函数将在 Value 为 Alloca 指令时进行特殊处理，在 load=1 时将
-   * Alloca 指针所指向的地址载入到分配的寄存器中。
-   * @note 该函数将在 Value 为常量时进行特殊处理，在 load=1 时将常量通过 LI
-   * 指令载入到分配的寄存器中。
-   * @attention 目前不应使用 direct 参数。
+   * 将寄存器 reg 中的值写入 Value 所在的寄存器或栈位。
+   */
+  void storeValue(Value *val, RiscvOperand *reg, RiscvBasicBlock *bb);
+
+  /**
+   * 在基本块 bb 末尾插入一组并行复制。各项的读取视为同时发生，
+   * 存在环时借助 t3/ft3 打破。
+   */
+  void parallelCopy(std::vector<CopyPair> copies, RiscvBasicBlock *bb);
+
+  /**
+   * 返回 Value 当前所在的位置：寄存器、栈位，或需要临时生成时返回 nullptr 。
    */
-  RiscvOperand *findSpecificReg(Value *val, std::string RegName,
-                                RiscvBasicBlock *bb,
-                                RiscvInstr *instr = nullptr,
-                                bool direct = true);
+  RiscvOperand *getLocation(Value *val);
 
   /**
    * 将 Value 与指定的物理地址操作数 offset(rs) 相关联。
@@ -169,22 +182,9 @@ public:
   void setPosition(Value *val, RiscvOperand *riscvVal);
 
   /**
-   * 将 Value 与指定的寄存器 rs 相关联。若寄存器内已有值，则将值写回。
-   * @param val 需要关联的 Value
-   * @param riscvReg 被关联的寄存器 rs
-   * @param bb 用于插入的基本块
-   * @param instr 在 instr 之前插入指令（可选）
-   * @attention 在大多数情况下你不应直接使用此函数。作为替代，你应该使用 findReg
-   * 与 findSpecificReg 函数来进行关联。
-   */
-  void setPositionReg(Value *val, RiscvOperand *riscvReg, RiscvBasicBlock *bb,
-                      RiscvInstr *instr = nullptr);
-  /**
-   * 将 Value 与指定的寄存器 rs 相关联。若寄存器内已有值，则将值写回。
+   * 将 Value 与指定的寄存器 rs 相关联。
    * @param val 需要关联的 Value
    * @param riscvReg 被关联的寄存器 rs
-   * @attention 在大多数情况下你不应直接使用此函数。作为替代，你应该使用 findReg
-   * 与 findSpecificReg 函数来进行关联。
    */
   void setPositionReg(Value *val, RiscvOperand *riscvReg);
 
@@ -198,31 +198,7 @@ public:
   void setPointerPos(Value *val, RiscvOperand *PointerMem);
 
   /**
-   * 将寄存器内容写回到内存地址中，并移除该寄存器在pos中映射的地址。
-   * @param riscvReg 将要写回的寄存器
-   * @param bb 指令将要插入的基本块
-   * @param instr 当前需要在哪一条指令前方插入sw指令
-   * @return 返回最后写入的指令
-   */
-  RiscvInstr *writeback(RiscvOperand *riscvReg, RiscvBasicBlock *bb,
-                        RiscvInstr *instr = nullptr);
-  /**
-   * 将 Value 所关联的寄存器写回到内存地址中，并移除该寄存器在pos中映射的地址。
-   * @param val 将要写回的 Value
-   * @param bb 指令将要插入的基本块
-   * @param instr 当前需要在哪一条指令前方插入sw指令
-   * @return 返回最后写入的指令
-   */
-  RiscvInstr *writeback(Value *val, RiscvBasicBlock *bb,
-                        RiscvInstr *instr = nullptr);
-
-  /**
-   * 返回寄存器 reg 所对应的 Value 。
-   */
-  Value *getRegPosition(RiscvOperand *reg);
-
-  /**
-   * 返回 Value 所对应的寄存器 reg 。
+   * 返回 Value 所对应的寄存器 reg ，未分配寄存器时返回 nullptr 。
    */
   RiscvOperand *getPositionReg(Value *val);
 
@@ -239,6 +215,9 @@ public:
   // 指针所指向的内存地址
   std::map<Value *, RiscvOperand *> ptrPos;
 
+  // 被溢出到栈上的变量（并查集代表）
+  std::vector<Value *> spilled;
+
   /**
    * 返回指针类型的 Value 所指向的常量相对物理地址操作数 offset(sp) 。
    * @attention 参数 bb, instr 目前不被使用。
@@ -247,14 +226,15 @@ public:
                         RiscvInstr *instr = nullptr);
 
   /**
-   * 写回所有与内存存在关联的寄存器并删除关联。
+   * 将当前指令中被溢出变量的结果从临时寄存器写回栈上。
+   * 每翻译完一条 IR 指令后调用。
    * @param bb 被插入基本块
    * @param instr 在特定指令前插入
    */
   void writeback_all(RiscvBasicBlock *bb, RiscvInstr *instr = nullptr);
 
   /**
-   * 清空所有寄存器关系。
+   * 清空临时寄存器的使用情况。
    */
   void clear();
 
@@ -264,25 +244,91 @@ public:
   std::set<RiscvOperand *> getUsedReg() { return regUsed; }
 
 private:
+  friend class GraphColoring;
   std::map<Value *, RiscvOperand *> pos, curReg;
-  std::map<RiscvOperand *, Value *> regPos;
   /**
-   * 安全寄存器寻找。用于确保寄存器在被寻找之后的 SAFE_FIND_LIMIT
-   * 个时间戳内不被写回。
+   * 活跃区间及其分配时的寄存器偏好（如参数寄存器、phi 的入值所在寄存器）。
+   */
+  std::vector<LiveInterval> intervals;
+  std::map<Value *, RiscvOperand *> hint;
+  std::map<Value *, std::vector<Value *>> related; // phi 与其入值
+  void collectHints(Function *foo);
+  void buildIntervals(Function *foo);
+  void linearScan();
+  /**
+   * 当前指令已使用的操作数临时寄存器数，与等待写回的结果。
    */
-  std::map<RiscvOperand *, int> regFindTimeStamp;
-  int safeFindTimeStamp = 0;
-  static const int SAFE_FIND_LIMIT = 3;
+  int scratchCount = 0;
+  std::vector<std::pair<Value *, RiscvOperand *>> pendingStore;
+  void emitCopy(RiscvOperand *dest, RiscvOperand *src, Type *ty,
+                RiscvBasicBlock *bb);
   /**
    * 被使用过的寄存器。
    */
   std::set<RiscvOperand *> regUsed;
 };
 
+// 迭代合并图着色分配器（George & Appel）。
+// 结点为并查集代表的变量，传送指令为 phi 与其各入值之间的复制；
+// 可以合并的传送指令在分配后通过并查集合并，翻译时不再生成复制。
+// 溢出的代价为各次定义与使用按所在循环深度加权（每层乘 10）之和。
+// 被溢出的变量在整个函数内位于栈上，翻译时使用临时寄存器，因此无需重写代码后重新着色。
+class GraphColoring {
+public:
+  GraphColoring(RegAlloca *regAlloca) : regAlloca(regAlloca) {}
+  void execute(Function *foo);
+
+private:
+  RegAlloca *regAlloca;
+  enum NodeState { Simplify, Freeze, Spill, Spilled, Coalesced, Colored, Select };
+  enum MoveState { WorklistMove, ActiveMove, CoalescedMove, ConstrainedMove, FrozenMove };
+
+  // 结点信息
+  std::vector<Value *> node;
+  std::map<Value *, int> id;
+  std::vector<std::set<int>> adjList;
+  std::vector<int> degree, alias, state;
+  std::vector<bool> crossCall; // 跨越函数调用的结点只能使用被调用者保存的寄存器
+  std::vector<double> cost;
+  std::vector<RiscvOperand *> color, hint;
+  std::vector<std::vector<int>> moveList;
+
+  // 传送指令
+  std::vector<std::pair<int, int>> moves;
+  std::vector<int> moveState;
+
+  std::set<int> simplifyWorklist, freezeWorklist, spillWorklist, worklistMoves;
+  std::vector<int> selectStack;
+
+  int getNode(Value *val);
+  void addEdge(int u, int v);
+  void build(Function *foo);
+  const std::vector<RiscvOperand *> &colorsOf(int n);
+  int K(int n) { return colorsOf(n).size(); }
+  std::vector<int> adjacent(int n);
+  std::vector<int> nodeMoves(int n);
+  bool moveRelated(int n) { return !nodeMoves(n).empty(); }
+  void makeWorklist();
+  void simplify();
+  void decrementDegree(int m);
+  void enableMoves(int n);
+  void coalesce();
+  void addWorklist(int u);
+  bool conservative(int u, int v);
+  int getAlias(int n);
+  void combine(int u, int v);
+  void freeze();
+  void freezeMoves(int u);
+  void selectSpill();
+  void assignColors();
+  void apply();
+};
+
 /**
- * 寄存器对象池。
+ * 返回可分配的寄存器，调用者保存的寄存器在前。
+ * @param crossCall 为真时只返回被调用者保存的寄存器
  */
-static std::vector<RiscvOperand *> regPool;
+const std::vector<RiscvOperand *> &allocatableRegs(bool isFloat, bool crossCall);
 
 /**
  * 根据提供的寄存器名，从寄存器池中返回操作数。
@@ -34,7 +34,6 @@ std::string RiscvBasicBlock::print() {
 // 出栈顺序和入栈相反
 // 建议不使用pop语句，直接从栈中取值，最后直接修改sp的值即可
 // 使用一个单独的return block以防止多出口return
-extern int LabelCount;
 
 RiscvOperand::OpTy RiscvOperand::getType() { return tid_; }
 
@@ -102,11 +101,11 @@ std::string RiscvGlobalVariable::print(bool print_name, Constant *initVal) {
 
 std::string RiscvGlobalVariable::print() { return print(true, nullptr); }
 
-RiscvFunction *createSyslibFunc(Function *foo) {
+RiscvFunction *createSyslibFunc(Function *foo, RiscvBuilder *builder) {
   if (foo->name_ == "__aeabi_memclr4") {
     auto *rfoo = createRiscvFunction(foo);
     // 预处理块
-    auto *bb1 = createRiscvBasicBlock();
+    auto *bb1 = builder->createRiscvBasicBlock();
     bb1->addInstrBack(new MoveRiscvInst(getRegOperand("t5"),
                                         getRegOperand("a0"), bb1));
     bb1->addInstrBack(new MoveRiscvInst(getRegOperand("t6"),
@@ -116,7 +115,7 @@ RiscvFunction *createSyslibFunc(Function *foo) {
                                           getRegOperand("t6"), bb1));
     bb1->addInstrBack(
         new MoveRiscvInst(getRegOperand("a0"), new RiscvConst(0), bb1));
-    auto *bb2 = createRiscvBasicBlock();
+    auto *bb2 = builder->createRiscvBasicBlock();
     // 循环块
     // 默认clear为全0
     bb2->addInstrBack(new StoreRiscvInst(
@@ -339,5 +339,7 @@ public:
 
 Type *findPtrType(Type *ty);
 
-RiscvFunction *createSyslibFunc(Function *foo);
+class RiscvBuilder;
+// 库函数的基本块由 builder 创建并编号
+RiscvFunction *createSyslibFunc(Function *foo, RiscvBuilder *builder);
 #endif // !RISCVH
\ No newline at end of file
@@ -1 +1,118 @@
-// Currently a dummy file
+#include "utils.h"
+#include <algorithm>
+#include <iomanip>
+#include <vector>
+
+bool enableStats = false;
+bool enableTimeReport = false;
+
+// 按首次出现的顺序输出，便于与编译流程对照；可能在多个线程中同时记录
+static std::vector<std::pair<std::string, long long>> stats;
+static std::vector<std::pair<std::string, double>> times;
+static std::mutex statsMutex;
+
+template <typename T>
+static void accumulate(std::vector<std::pair<std::string, T>> &list,
+                       const std::string &name, T value) {
+  std::lock_guard<std::mutex> guard(statsMutex);
+  for (auto &[key, sum] : list)
+    if (key == name) {
+      sum += value;
+      return;
+    }
+  list.push_back({name, value});
+}
+
+void addStat(const std::string &name, long long value) {
+  if (enableStats)
+    accumulate(stats, name, value);
+}
+
+void printStats(std::ostream &os) {
+  for (auto &[name, value] : stats)
+    os << "stat " << name << " " << value << "\n";
+}
+
+void addTime(const std::string &name, double seconds) {
+  accumulate(times, name, seconds);
+}
+
+void printTimeReport(std::ostream &os) {
+  double total = 0;
+  os << std::fixed << std::setprecision(6);
+  for (auto &[name, seconds] : times) {
+    os << "time " << name << " " << seconds << "\n";
+    // pass 的耗时已包含在 opt 中
+    if (name.find('.') == std::string::npos)
+      total += seconds;
+  }
+  os << "time total " << total << "\n";
+}
+
+ThreadPool::ThreadPool(int threads) {
+  for (int i = 1; i < threads; i++)
+    workers.emplace_back([this] { work(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    stop = true;
+  }
+  wakeup.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+void ThreadPool::work() {
+  long long seen = 0;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    wakeup.wait(lock, [&] { return stop || batch != seen; });
+    if (stop)
+      return;
+    seen = batch;
+    drain(lock);
+  }
+}
+
+void ThreadPool::drain(std::unique_lock<std::mutex> &lock) {
+  while (next < total) {
+    int index = next++;
+    running++;
+    lock.unlock();
+    (*task)(index);
+    lock.lock();
+    if (--running == 0 && next == total)
+      finished.notify_all();
+  }
+}
+
+void ThreadPool::run(int n, const std::function<void(int)> &task_) {
+  if (workers.empty() || n <= 1) {
+    for (int i = 0; i < n; i++)
+      task_(i);
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  task = &task_;
+  next = 0;
+  total = n;
+  batch++;
+  wakeup.notify_all();
+  drain(lock);
+  finished.wait(lock, [&] { return running == 0; });
+  task = nullptr;
+  total = 0;
+}
+
+static int poolSize = 0;
+
+void setThreadPoolSize(int threads) { poolSize = threads; }
+
+ThreadPool &getThreadPool() {
+  static ThreadPool pool(
+      poolSize > 0 ? poolSize
+                   : std::max(1u, std::thread::hardware_concurrency()));
+  return pool;
+}
@@ -0,0 +1,70 @@
+#ifndef UTILSH
+#define UTILSH
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// -stats：各个 pass 的效果计数，如删除的指令数、溢出的变量数
+extern bool enableStats;
+void addStat(const std::string &name, long long value = 1);
+// 每行输出 "stat <名称> <数值>"
+void printStats(std::ostream &os);
+
+// -ftime-report：各编译阶段的耗时，同名阶段累加
+extern bool enableTimeReport;
+void addTime(const std::string &name, double seconds);
+// 每行输出 "time <名称> <秒数>"，最后一行为总耗时 "time total <秒数>"
+void printTimeReport(std::ostream &os);
+
+// 在作用域结束时将经过的时间计入 name
+class PhaseTimer {
+  std::string name;
+  std::chrono::steady_clock::time_point start;
+
+public:
+  explicit PhaseTimer(const std::string &name_)
+      : name(name_), start(std::chrono::steady_clock::now()) {}
+  ~PhaseTimer() {
+    if (enableTimeReport)
+      addTime(name, std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start)
+                        .count());
+  }
+};
+
+// 固定数量的工作线程，用于并行执行一组相互独立的任务。
+// 调用 run 的线程也参与执行，threads 为 1 时不创建工作线程。
+class ThreadPool {
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wakeup, finished;
+  // 当前这一批任务：task(next) ... task(total - 1) 尚未开始
+  const std::function<void(int)> *task = nullptr;
+  int next = 0, total = 0, running = 0;
+  long long batch = 0; // 批次编号，工作线程据此判断是否有新任务
+  bool stop = false;
+
+  void work();
+  // 执行当前批次中剩余的任务，直到全部被取走
+  void drain(std::unique_lock<std::mutex> &lock);
+
+public:
+  explicit ThreadPool(int threads);
+  ~ThreadPool();
+  int size() { return workers.size() + 1; }
+  // 执行 task(0) ... task(n - 1) 并等待全部完成，任务之间的执行顺序不确定
+  void run(int n, const std::function<void(int)> &task_);
+};
+
+// 全局线程池，线程数默认为硬件线程数
+ThreadPool &getThreadPool();
+// -j N：在首次使用线程池之前设置其线程数
+void setThreadPoolSize(int threads);
+
+#endif // !UTILSH